@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+
+#include "ringlog.hpp"
+
+namespace {
+
+struct NullBuffer : std::streambuf {
+  int overflow(int c) override { return c; }
+};
+
+constexpr std::size_t iterations = 1 << 16;
+
+void run(am::RingLog &log, std::uint32_t id, const char *name) {
+  std::size_t dropped = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    if (!log.log(id, i, std::string_view("client"), 1.25)) {
+      dropped++;
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%s: %.1f ns per log call, %zu dropped of %zu\n", name,
+              elapsed.count() / iterations, dropped, iterations);
+}
+
+} // namespace
+
+int main() {
+  NullBuffer null_buffer;
+  std::ostream null_stream(&null_buffer);
+  am::RingLog log(null_stream, 1 << 22);
+  auto id = log.register_format("request {} from {} took {} ms");
+
+  // first pass touches every page of the thread ring
+  run(log, id, "cold ring");
+  log.drain();
+  run(log, id, "hot path");
+  log.drain();
+
+  log.start();
+  run(log, id, "with background drain");
+  log.stop();
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "shardedring.hpp"
+
+namespace {
+
+constexpr std::size_t records_per_producer = 1 << 20;
+constexpr std::size_t record_size = 16;
+constexpr std::size_t batch = 64;
+
+// producers are skewed: all of them push into the first half of the shards,
+// so consumers of the second half only make progress by stealing
+void run(std::size_t threads) {
+  am::ShardedRing ring(threads, 1 << 16);
+  std::atomic<std::size_t> consumed{};
+  const std::size_t total = threads * records_per_producer;
+
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&ring, t, threads] {
+      char record[record_size]{};
+      auto shard = ring.shard_for_key(t % ((threads + 1) / 2));
+      for (std::size_t i = 0; i < records_per_producer;) {
+        if (ring.try_push(shard, am::bytes_view(record, record_size))) {
+          i++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    workers.emplace_back([&ring, &consumed, t, total] {
+      std::size_t sum = 0;
+      while (consumed.load(std::memory_order_relaxed) < total) {
+        auto n = ring.drain(t, batch, [&sum](std::string_view r) {
+          sum += r.size();
+        });
+        if (n) {
+          consumed.fetch_add(n, std::memory_order_relaxed);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%zu shards, %zu producers, %zu consumers: %.2f Mrec/s, "
+              "stolen %zu\n",
+              threads, threads, threads, total / elapsed.count() / 1e6,
+              ring.stolen());
+}
+
+} // namespace
+
+int main() {
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0)
+    max_threads = 4;
+  for (std::size_t t = 1; t < max_threads; t *= 2) {
+    run(t);
+  }
+  run(max_threads);
+  return 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <utility>
+
+namespace am {
+
+/// Shared flag plus callbacks run once when it is set.
+struct CancellationState {
+  bool cancelled_{};
+  // callbacks are running, the list is still there
+  bool cancelling_{};
+  std::list<std::function<void()>> callbacks_{};
+};
+
+/// Observes a CancellationSource, default constructed tokens never cancel.
+struct CancellationToken {
+  /// Keeps a callback registered while alive, O(1) to remove.
+  struct Registration {
+    Registration() = default;
+    Registration(std::shared_ptr<CancellationState> state,
+                 std::list<std::function<void()>>::iterator it)
+        : state_(std::move(state))
+        , it_(it) {}
+    ~Registration() { reset(); }
+    Registration(const Registration &) = delete;
+    Registration(Registration &&) = delete;
+    Registration &operator=(const Registration &) = delete;
+    Registration &operator=(Registration &&) = delete;
+
+    void reset() noexcept {
+      if (auto state = state_.lock()) {
+        if (!state->cancelled_) {
+          state->callbacks_.erase(it_);
+        } else if (state->cancelling_) {
+          // cancel() skips it, the list is cleared once it is done
+          *it_ = nullptr;
+        }
+      }
+      state_.reset();
+    }
+
+  private:
+    friend CancellationToken;
+
+    std::weak_ptr<CancellationState> state_{};
+    std::list<std::function<void()>>::iterator it_{};
+  };
+
+  CancellationToken() = default;
+  explicit CancellationToken(std::shared_ptr<CancellationState> state)
+      : state_(std::move(state)) {}
+
+  bool can_be_cancelled() const noexcept { return state_ != nullptr; }
+  bool cancelled() const noexcept { return state_ && state_->cancelled_; }
+
+  /// Callback runs once from CancellationSource::cancel, unless the
+  /// registration is reset or destroyed before.
+  void on_cancel(Registration &registration, std::function<void()> callback) {
+    registration.reset();
+    if (!state_ || state_->cancelled_) {
+      return;
+    }
+    state_->callbacks_.push_back(std::move(callback));
+    registration.state_ = state_;
+    registration.it_ = std::prev(state_->callbacks_.end());
+  }
+
+private:
+  std::shared_ptr<CancellationState> state_{};
+};
+
+struct CancellationSource {
+  CancellationSource()
+      : state_(std::make_shared<CancellationState>()) {}
+
+  CancellationToken token() const { return CancellationToken(state_); }
+  bool cancelled() const noexcept { return state_->cancelled_; }
+
+  void cancel() {
+    // a callback can destroy the source
+    auto state = state_;
+    if (state->cancelled_) {
+      return;
+    }
+    state->cancelled_ = true;
+    state->cancelling_ = true;
+    // a callback can reset registrations of callbacks which didn't run yet,
+    // e.g. by destroying another waiting coroutine, they are skipped
+    for (auto &node : state->callbacks_) {
+      auto callback = std::move(node);
+      node = nullptr;
+      if (callback) {
+        callback();
+      }
+    }
+    state->cancelling_ = false;
+    state->callbacks_.clear();
+  }
+
+private:
+  std::shared_ptr<CancellationState> state_;
+};
+
+} // namespace am
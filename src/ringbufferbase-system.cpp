@@ -1,14 +1,21 @@
 #include "ringbufferbase-system.hpp"
 
+#include <atomic>
 #include <cstddef>
 #include <exception>
+#include <functional>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #if defined(_WIN32) || defined(_WIN64)
 #  include <windows.h>
 #endif
 
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
 #if defined(__APPLE__) || defined(__linux__)
 #  include <fcntl.h>
 #  include <sys/mman.h>
@@ -41,7 +48,8 @@ LinearMemInfo::LinearMemInfo(std::size_t minsize) {
 }
 
 LinearMemInfo::~LinearMemInfo() {
-  if (res_ != 0)
+  // a failed init terminates, see the constructor
+  if (res_ == 0)
     free(*this);
 }
 
@@ -51,7 +59,8 @@ int LinearMemInfo::init(std::size_t minsize) {
 #if defined(__APPLE__) || defined(__linux__)
   // source https: // github.com/lava/linear_ringbuffer
   pid_t pid = getpid();
-  static int counter = 0;
+  // rings can be created from several threads, names must stay unique
+  static std::atomic<int> counter = 0;
   std::size_t pagesize = ::sysconf(_SC_PAGESIZE);
   std::size_t bytes = minsize & ~(pagesize - 1);
   if (minsize % pagesize) {
@@ -93,6 +102,8 @@ int LinearMemInfo::init(std::size_t minsize) {
     perror("mmap2");
     return -1;
   }
+  // the mappings keep the shared memory object alive
+  ::close(fd);
   p1_[0] = 'x';
   printf("pointer %s: %p %p %p %ld %c %c\n", shname_.c_str(), p, p1_, p2_,
          (char *)p2_ - (char *)p1_, p1_[0], p2_[0]);
@@ -105,7 +116,7 @@ int LinearMemInfo::init(std::size_t minsize) {
 #else
   // source https://gist.github.com/rygorous/3158316
   DWORD pid = GetCurrentProcessId();
-  static int counter = 0;
+  static std::atomic<int> counter = 0;
   std::size_t pagesize = system_page_size();
   std::size_t bytes = minsize & ~(pagesize - 1);
   if (minsize % pagesize) {
@@ -167,4 +178,16 @@ std::size_t system_page_size() {
 #endif
 }
 
+std::size_t current_cpu() {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0)
+    return cpu;
+#elif defined(_WIN32) || defined(_WIN64)
+  return GetCurrentProcessorNumber();
+#endif
+  // no cheap way to ask, threads at least stay on the same shard
+  return std::hash<std::thread::id>{}(std::this_thread::get_id());
+}
+
 } // namespace am
@@ -24,5 +24,6 @@ struct LinearMemInfo {
 };
 
 std::size_t system_page_size();
+std::size_t current_cpu();
 
 } // namespace am
@@ -2,8 +2,10 @@
 
 #include "ringbufferbase-system.hpp"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
+#include <memory>
 #include <span>
 #include <stdexcept>
 #include <string_view>
@@ -11,17 +13,23 @@
 
 namespace am {
 
-LinnearArray::LinnearArray(std::size_t size)
+LinnearArray::LinnearArray(std::size_t size, RingStorage storage)
     : ptr_(nullptr)
-    , len_(0)
-    , mapped_(size) {
-  len_ = mapped_.len_;
-  ptr_ = mapped_.p1_;
+    , len_(0) {
+  if (storage == RingStorage::compact) {
+    heap_ = std::make_unique<char[]>(size);
+    len_ = size;
+    ptr_ = heap_.get();
+    return;
+  }
+  mapped_.emplace(size);
+  len_ = mapped_->len_;
+  ptr_ = mapped_->p1_;
 }
 
 std::size_t LinnearArray::size() const { return len_; }
 
-inline char *LinnearArray::data() { return ptr_; }
+bool LinnearArray::mirrored() const { return mapped_.has_value(); }
 
 const char *LinnearArray::data() const { return ptr_; }
 
@@ -32,8 +40,8 @@ std::vector<char> LinnearArray::to_vector() {
 }
 
 RingBufferBase::RingBufferBase(std::size_t size, std::size_t low_watermark,
-                               std::size_t high_watermark)
-    : _data(size)
+                               std::size_t high_watermark, RingStorage storage)
+    : _data(size, storage)
     , _size(_data.size())
     , filled_start_(0)
     , filled_size_(0)
@@ -47,6 +55,10 @@ void RingBufferBase::reset() {
   filled_size_ = 0;
   non_filled_start_ = 0;
   non_filled_size_ = _size;
+  // dropped bytes count as read
+  read_offset_ = write_offset_;
+  mark_ = 0;
+  on_commit_();
 }
 
 void RingBufferBase::commit(std::size_t len) {
@@ -54,6 +66,8 @@ void RingBufferBase::commit(std::size_t len) {
   filled_size_ -= len;
   filled_start_ += len;
   filled_start_ %= _size;
+  read_offset_ += len;
+  mark_ = mark_ > len ? mark_ - len : 0;
   on_commit_();
 }
 
@@ -62,6 +76,7 @@ void RingBufferBase::consume(std::size_t len) {
   non_filled_size_ -= len;
   non_filled_start_ += len;
   non_filled_start_ %= _size;
+  write_offset_ += len;
   on_consume_();
 }
 
@@ -100,6 +115,12 @@ std::size_t RingBufferBase::ready_write_size() const {
   return non_filled_size_;
 }
 
+bool RingBufferBase::mirrored() const { return _data.mirrored(); }
+
+std::uint64_t RingBufferBase::write_offset() const { return write_offset_; }
+
+std::uint64_t RingBufferBase::read_offset() const { return read_offset_; }
+
 bool RingBufferBase::below_high_watermark() const {
   return ready_size() < _high_watermark;
 }
@@ -130,7 +151,7 @@ using raw_int = union {
 int RingBufferBase::peek_int() const {
   check(4, "peek_int");
   int ret = 0;
-  if (filled_size_ + 4 < _size) {
+  if (filled_start_ + 4 <= _size) {
     std::memcpy(&ret, &_data.at(filled_start_), sizeof(ret));
   } else {
     raw_int ri;
@@ -165,13 +186,55 @@ buffers_2<std::span<const char>> RingBufferBase::peek_span(int len) const {
   }
 }
 
+void RingBufferBase::linearize() {
+  auto *begin = _data.data();
+  std::rotate(begin, begin + filled_start_, begin + _size);
+  filled_start_ = 0;
+  non_filled_start_ = filled_size_ % _size;
+}
+
 std::span<char> RingBufferBase::peek_linear_span(int len) {
   check(len, "peek_linear_span");
+  if (!_data.mirrored() && filled_start_ + len > _size) {
+    linearize();
+  }
   static_assert(std::same_as<LinnearArray, decltype(_data)>,
                 "_data should be linear array, to support liear view");
   return {&_data.at(filled_start_), static_cast<std::size_t>(len)};
 }
 
+std::span<char> RingBufferBase::prepared_linear_span(int len) {
+  if (len < 0 || static_cast<std::size_t>(len) > non_filled_size_) {
+    throw std::runtime_error("bad state");
+  }
+  if (!_data.mirrored() && non_filled_start_ + len > _size) {
+    linearize();
+  }
+  static_assert(std::same_as<LinnearArray, decltype(_data)>,
+                "_data should be linear array, to support liear view");
+  return {&_data.at(non_filled_start_), static_cast<std::size_t>(len)};
+}
+
 std::size_t RingBufferBase::peek_pos() const { return filled_start_; }
 
+std::size_t RingBufferBase::mark() const { return mark_; }
+
+std::size_t RingBufferBase::unparsed_size() const {
+  return filled_size_ - mark_;
+}
+
+void RingBufferBase::advance_mark(std::size_t len) {
+  check(static_cast<int>(mark_ + len), "advance_mark");
+  mark_ += len;
+}
+
+void RingBufferBase::rewind() { mark_ = 0; }
+
+void RingBufferBase::commit_to_mark() { commit(mark_); }
+
+std::span<char> RingBufferBase::peek_unparsed_linear_span(int len) {
+  auto span = peek_linear_span(static_cast<int>(mark_) + len);
+  return span.subspan(mark_);
+}
+
 } // namespace am
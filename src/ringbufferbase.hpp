@@ -3,10 +3,12 @@
 #include "ringbufferbase-system.hpp"
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <span>
 #include <string_view>
 #include <vector>
@@ -60,13 +62,25 @@ private:
   std::size_t buffer_count_;
 };
 
+/// How ring memory is allocated.
+/**
+ * mirrored maps the same pages twice in a row, any sequence is linear in
+ * memory. It takes at least two system pages (64 KiB on Windows) and a file
+ * mapping. compact is a plain heap allocation of exactly the requested size,
+ * for small rings. Linear views of a compact ring move the filled sequence to
+ * the start of the buffer when it wraps around, which invalidates views
+ * taken before.
+ */
+enum class RingStorage { mirrored, compact };
+
 struct LinnearArray {
-  LinnearArray(std::size_t size);
+  LinnearArray(std::size_t size, RingStorage storage = RingStorage::mirrored);
   std::size_t size() const;
+  bool mirrored() const;
   inline char &at(std::size_t pos) { return *(ptr_ + pos); }
   inline const char &at(std::size_t pos) const { return *(ptr_ + pos); }
 
-  inline char *data();
+  inline char *data() { return ptr_; }
   const char *data() const;
 
   std::vector<char> to_vector();
@@ -74,15 +88,18 @@ struct LinnearArray {
 private:
   char *ptr_;
   std::size_t len_;
-  LinearMemInfo mapped_;
+  std::optional<LinearMemInfo> mapped_;
+  std::unique_ptr<char[]> heap_;
 };
 
 
 
 struct RingBufferBase {
   RingBufferBase(std::size_t size, std::size_t low_watermark,
-             std::size_t high_watermark);
+             std::size_t high_watermark,
+             RingStorage storage = RingStorage::mirrored);
 
+  /// Drops the filled sequence, wakes up waiters like a commit of it.
   void reset();
 
   /// Reduce filled sequence by marking first size bytes of filled sequence as
@@ -109,8 +126,16 @@ struct RingBufferBase {
   void memcpy_out(void *data, size_t sz);
 
   bool empty() const;
+  /// False for RingStorage::compact, see RingStorage.
+  bool mirrored() const;
   std::size_t ready_size() const;
   std::size_t ready_write_size() const;
+  /// Stream offset of the next byte to be written, counts every byte ever
+  /// written.
+  std::uint64_t write_offset() const;
+  /// Stream offset of the next byte to be read, every byte before it was
+  /// committed.
+  std::uint64_t read_offset() const;
   bool below_high_watermark() const;
   bool below_low_watermark() const;
 
@@ -120,9 +145,28 @@ struct RingBufferBase {
   buffers_2<std::string_view> peek_string_view(int len) const;
   buffers_2<bytes_view> peek_span(int len) const;
   std::span<char> peek_linear_span(int len);
+  std::span<char> prepared_linear_span(int len);
   std::size_t peek_pos() const;
 
+  /// Parser cursor: bytes of the filled sequence already parsed.
+  /**
+   * The mark survives suspensions, an incremental parser resumes scanning at
+   * the mark instead of the start of the filled sequence. commit moves the
+   * mark back together with the start of the filled sequence.
+   */
+  std::size_t mark() const;
+  std::size_t unparsed_size() const;
+  void advance_mark(std::size_t len);
+  /// Forgets parsed state, next parse starts from the filled sequence start.
+  void rewind();
+  /// Commits everything parsed, e.g. once a message is complete.
+  void commit_to_mark();
+  /// Linear view of len bytes after the mark.
+  std::span<char> peek_unparsed_linear_span(int len);
+
 protected:
+  void linearize();
+
   LinnearArray _data;
 
   std::size_t _size;
@@ -132,6 +176,9 @@ protected:
   std::size_t non_filled_size_;
   std::size_t _low_watermark;
   std::size_t _high_watermark;
+  std::uint64_t write_offset_{};
+  std::uint64_t read_offset_{};
+  std::size_t mark_{};
   std::function<void()> on_commit_{};
   std::function<void()> on_consume_{};
 };
@@ -1,11 +1,70 @@
 #include "ringbuffercoro.hpp"
+#include <algorithm>
 #include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace am {
 
+namespace {
+
+void notify_selectors(
+    std::vector<std::pair<RingSelector *, std::size_t>> &selectors) {
+  // a resumed coroutine can add or remove selectors, removal shifts the
+  // vector, so walk a copy and skip the ones which are gone
+  auto snapshot = selectors;
+  for (auto entry : snapshot) {
+    if (std::find(selectors.begin(), selectors.end(), entry) !=
+        selectors.end()) {
+      entry.first->notify(entry.second);
+    }
+  }
+}
+
+} // namespace
+
+bool AwaiterDeadline::expired() {
+  if (token_.cancelled()) {
+    result_ = WaitResult::cancelled;
+    done_ = true;
+    return true;
+  }
+  if (wheel_ && wheel_->now() >= deadline_) {
+    result_ = WaitResult::timeout;
+    done_ = true;
+    return true;
+  }
+  return false;
+}
+
+void AwaiterDeadline::arm() {
+  if (wheel_) {
+    wheel_->arm(timer_, deadline_, [this]() { wake(WaitResult::timeout); });
+  }
+  token_.on_cancel(cancel_registration_, [this]() {
+    if (!done_) {
+      wake(WaitResult::cancelled);
+    }
+  });
+}
+
+void AwaiterDeadline::wake(WaitResult result) {
+  done_ = true;
+  result_ = result;
+  timer_.cancel();
+  cancel_registration_.reset();
+  auto unlink = std::move(unlink_);
+  unlink_ = nullptr;
+  if (unlink) {
+    unlink();
+  }
+  coro_();
+}
+
 RingBufferCoro::AwaiterNotFull::AwaiterNotFull(std::size_t min_size,
                                                am::RingBufferCoro &ring_buffer)
     : min_size_(min_size)
@@ -16,30 +75,52 @@ RingBufferCoro::AwaiterNotEmpty::AwaiterNotEmpty(
     : min_size_(min_size)
     , ring_buffer_(ring_buffer) {}
 
+RingBufferCoro::AwaiterConsumed::AwaiterConsumed(
+    std::uint64_t offset, am::RingBufferCoro &ring_buffer)
+    : ring_buffer_(ring_buffer)
+    , offset_(offset) {}
+
 bool RingBufferCoro::AwaiterNotFull::await_ready() {
-  return ring_buffer_.ready_write_size() >= min_size_;
+  return ring_buffer_.ready_write_size() >= min_size_ || expired();
 }
 
-void RingBufferCoro::AwaiterNotFull::await_resume() {
-
+WaitResult RingBufferCoro::AwaiterNotFull::await_resume() {
+  return result_;
 }
 
 void RingBufferCoro::AwaiterNotFull::await_suspend(std::coroutine_handle<> h) {
   coro_ = h;
-  ring_buffer_.waiting_not_full_.emplace(shared_from_this());
+  auto &waiting = ring_buffer_.waiting_not_full_;
+  waiting.emplace_back(shared_from_this());
+  unlink_ = [&waiting, it = std::prev(waiting.end())]() { waiting.erase(it); };
+  arm();
 }
 
 bool RingBufferCoro::AwaiterNotEmpty::await_ready() {
-  return ring_buffer_.ready_size() >= min_size_;
+  return ring_buffer_.ready_size() >= min_size_ || expired();
 }
 
-void RingBufferCoro::AwaiterNotEmpty::await_resume() {
-
+WaitResult RingBufferCoro::AwaiterNotEmpty::await_resume() {
+  return result_;
 }
 
 void RingBufferCoro::AwaiterNotEmpty::await_suspend(std::coroutine_handle<> h) {
   coro_ = h;
-  ring_buffer_.waiting_not_empty_.emplace(shared_from_this());
+  auto &waiting = ring_buffer_.waiting_not_empty_;
+  waiting.emplace_back(shared_from_this());
+  unlink_ = [&waiting, it = std::prev(waiting.end())]() { waiting.erase(it); };
+  arm();
+}
+
+bool RingBufferCoro::AwaiterConsumed::await_ready() {
+  return ring_buffer_.read_offset() >= offset_;
+}
+
+void RingBufferCoro::AwaiterConsumed::await_resume() {}
+
+void RingBufferCoro::AwaiterConsumed::await_suspend(std::coroutine_handle<> h) {
+  coro_ = h;
+  ring_buffer_.waiting_consumed_.push({offset_, shared_from_this()});
 }
 
 std::shared_ptr<RingBufferCoro::AwaiterNotFull> RingBufferCoro::wait_not_full(std::size_t min_size) {
@@ -51,52 +132,136 @@ RingBufferCoro::wait_not_empty(std::size_t min_size) {
   return std::make_shared<RingBufferCoro::AwaiterNotEmpty>(min_size, *this);
 }
 
+std::shared_ptr<RingBufferCoro::AwaiterNotFull>
+RingBufferCoro::wait_not_full(std::size_t min_size, TimerWheel &wheel,
+                              TimerWheel::time_point deadline,
+                              CancellationToken token) {
+  auto awaiter = wait_not_full(min_size, std::move(token));
+  awaiter->wheel_ = &wheel;
+  awaiter->deadline_ = deadline;
+  return awaiter;
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterNotFull>
+RingBufferCoro::wait_not_full(std::size_t min_size, CancellationToken token) {
+  auto awaiter = wait_not_full(min_size);
+  awaiter->token_ = std::move(token);
+  return awaiter;
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterNotEmpty>
+RingBufferCoro::wait_not_empty(std::size_t min_size, TimerWheel &wheel,
+                               TimerWheel::time_point deadline,
+                               CancellationToken token) {
+  auto awaiter = wait_not_empty(min_size, std::move(token));
+  awaiter->wheel_ = &wheel;
+  awaiter->deadline_ = deadline;
+  return awaiter;
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterNotEmpty>
+RingBufferCoro::wait_not_empty(std::size_t min_size, CancellationToken token) {
+  auto awaiter = wait_not_empty(min_size);
+  awaiter->token_ = std::move(token);
+  return awaiter;
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterNotEmpty>
+RingBufferCoro::wait_unparsed(std::size_t more_size) {
+  return wait_not_empty(mark() + more_size);
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterNotEmpty>
+RingBufferCoro::wait_unparsed(std::size_t more_size, TimerWheel &wheel,
+                              TimerWheel::time_point deadline,
+                              CancellationToken token) {
+  return wait_not_empty(mark() + more_size, wheel, deadline, std::move(token));
+}
+
+std::shared_ptr<RingBufferCoro::AwaiterConsumed>
+RingBufferCoro::wait_consumed(std::uint64_t offset) {
+  return std::make_shared<RingBufferCoro::AwaiterConsumed>(offset, *this);
+}
+
 RingBufferCoro::RingBufferCoro(std::size_t size, std::size_t low_watermark,
-                 std::size_t high_watermark): RingBufferBase(size, low_watermark, high_watermark) {
+                 std::size_t high_watermark, RingStorage storage): RingBufferBase(size, low_watermark, high_watermark, storage) {
   on_commit_ = [this]() {
     auto &tmp = waiting_not_full_;
 
     while (!tmp.empty()) {
       auto cur_write_ready = ready_write_size();
-      if (auto awaiter = tmp.front().lock()) {
+      if (auto awaiter = tmp.front().lock(); awaiter && !awaiter->done_) {
         if (awaiter->min_size_ <= cur_write_ready) {
           std::cout << "ring: waking up producer\n";
-          awaiter->coro_();
-          tmp.pop();
+          // unlinks the awaiter
+          awaiter->wake(WaitResult::ready);
           woken_up_++;
         } else {
           break;
         }
       } else {
-        tmp.pop();
+        tmp.pop_front();
         woken_up_skipped_++;
         continue;
       }
     }
+    auto &consumed = waiting_consumed_;
+    while (!consumed.empty() && consumed.top().offset_ <= read_offset()) {
+      auto awaiter = consumed.top().awaiter_.lock();
+      consumed.pop();
+      if (awaiter) {
+        awaiter->coro_();
+        woken_up_++;
+      } else {
+        woken_up_skipped_++;
+      }
+    }
+    notify_selectors(selecting_not_full_);
   };
   on_consume_ = [this]() {
     auto &tmp = waiting_not_empty_;
 
     while (!tmp.empty()) {
       auto cur_ready = ready_size();
-      if (auto awaiter = tmp.front().lock()) {
+      if (auto awaiter = tmp.front().lock(); awaiter && !awaiter->done_) {
         if (awaiter->min_size_ <= cur_ready) {
           std::cout << "ring: waking up producer\n";
-          awaiter->coro_();
-          tmp.pop();
+          // unlinks the awaiter
+          awaiter->wake(WaitResult::ready);
           woken_up_++;
         } else {
           break;
         }
       } else {
-        tmp.pop();
+        tmp.pop_front();
         woken_up_skipped_++;
         continue;
       }
     }
+    notify_selectors(selecting_not_empty_);
   };
 }
 
+RingBufferCoro::~RingBufferCoro() {
+  // timers and tokens can still wake these once the ring is gone
+  for (auto &waiting : waiting_not_full_) {
+    if (auto awaiter = waiting.lock()) {
+      awaiter->unlink_ = nullptr;
+    }
+  }
+  for (auto &waiting : waiting_not_empty_) {
+    if (auto awaiter = waiting.lock()) {
+      awaiter->unlink_ = nullptr;
+    }
+  }
+  for (auto [selector, index] : selecting_not_full_) {
+    selector->detach(index);
+  }
+  for (auto [selector, index] : selecting_not_empty_) {
+    selector->detach(index);
+  }
+}
+
 std::size_t RingBufferCoro::woken_up() const noexcept {
   return woken_up_;
 }
@@ -1,51 +1,150 @@
 #pragma once
 
+#include "cancellation.hpp"
 #include "ringbufferbase.hpp"
+#include "ringselector.hpp"
+#include "timerwheel.hpp"
 #include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
 #include <queue>
+#include <utility>
+#include <vector>
 
 namespace am {
 
+/// Forwards to an awaiter owned by a shared_ptr, so co_await *awaiter never
+/// copies it (gcc 12 copies lvalue awaiters, which breaks shared_from_this).
+template <typename Awaiter> struct AwaiterRef {
+  bool await_ready() { return awaiter_.await_ready(); }
+  auto await_suspend(std::coroutine_handle<> h) {
+    return awaiter_.await_suspend(h);
+  }
+  auto await_resume() { return awaiter_.await_resume(); }
+
+  Awaiter &awaiter_;
+};
+
+/// Why a ring awaiter was resumed.
+enum class WaitResult { ready, timeout, cancelled };
+
+/// Deadline and cancellation of a ring awaiter.
+/**
+ * Whichever comes first of data movement, the timer or the token resumes
+ * the coroutine, the other two are disarmed and the awaiter is unlinked
+ * from the ring's queue, so a peer which stays silent doesn't grow it.
+ */
+struct AwaiterDeadline {
+  /// Sets result_ if the wait is over before suspending.
+  bool expired();
+  void arm();
+  /// Resumes the coroutine, the awaiter can be destroyed by the time it
+  /// returns.
+  void wake(WaitResult result);
+
+  TimerWheel *wheel_{};
+  TimerWheel::time_point deadline_{};
+  CancellationToken token_{};
+  TimerWheel::Timer timer_{};
+  CancellationToken::Registration cancel_registration_{};
+  // erases the awaiter from the ring's queue, set while it is queued
+  std::function<void()> unlink_{};
+  std::coroutine_handle<> coro_{};
+  WaitResult result_{WaitResult::ready};
+  bool done_{};
+};
+
 struct RingBufferCoro : public RingBufferBase {
 
-	struct AwaiterNotFull: std::enable_shared_from_this<AwaiterNotFull> {
+	struct AwaiterNotFull: AwaiterDeadline, std::enable_shared_from_this<AwaiterNotFull> {
           AwaiterNotFull(std::size_t min_size, RingBufferCoro &ring_buffer);
           bool await_ready();
           void await_suspend(std::coroutine_handle<> h);
-          void await_resume();
+          WaitResult await_resume();
+          AwaiterRef<AwaiterNotFull> operator co_await() & { return {*this}; }
 
           bool is_alive() const noexcept;
 
           RingBufferCoro &ring_buffer_;
           std::size_t min_size_;
-          std::coroutine_handle<> coro_{};
   };
-	struct AwaiterNotEmpty: std::enable_shared_from_this<AwaiterNotEmpty> {
+	struct AwaiterNotEmpty: AwaiterDeadline, std::enable_shared_from_this<AwaiterNotEmpty> {
           AwaiterNotEmpty(std::size_t min_size, RingBufferCoro &ring_buffer);
           bool await_ready();
           void await_suspend(std::coroutine_handle<> h);
-          void await_resume();
+          WaitResult await_resume();
+          AwaiterRef<AwaiterNotEmpty> operator co_await() & { return {*this}; }
 
           bool is_alive() const noexcept;
 
           RingBufferCoro &ring_buffer_;
           std::size_t min_size_;
-          std::coroutine_handle<> coro_{};
+  };
+  /// Resumed once every byte before offset was committed.
+  struct AwaiterConsumed : std::enable_shared_from_this<AwaiterConsumed> {
+    AwaiterConsumed(std::uint64_t offset, RingBufferCoro &ring_buffer);
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume();
+    AwaiterRef<AwaiterConsumed> operator co_await() & { return {*this}; }
+
+    RingBufferCoro &ring_buffer_;
+    std::uint64_t offset_;
+    std::coroutine_handle<> coro_{};
+  };
+
+  struct WaitingConsumed {
+    std::uint64_t offset_;
+    std::weak_ptr<AwaiterConsumed> awaiter_;
+    bool operator>(const WaitingConsumed &other) const {
+      return offset_ > other.offset_;
+    }
   };
 
   std::shared_ptr<AwaiterNotFull> wait_not_full(std::size_t guaranteed_free_size);
   std::shared_ptr<AwaiterNotEmpty> wait_not_empty(std::size_t guaranteed_filled_size);
+  /// Resumed with WaitResult::timeout once wheel reaches deadline, or with
+  /// WaitResult::cancelled when token is cancelled.
+  std::shared_ptr<AwaiterNotFull>
+  wait_not_full(std::size_t guaranteed_free_size, TimerWheel &wheel,
+                TimerWheel::time_point deadline, CancellationToken token = {});
+  std::shared_ptr<AwaiterNotFull> wait_not_full(std::size_t guaranteed_free_size,
+                                                CancellationToken token);
+  std::shared_ptr<AwaiterNotEmpty>
+  wait_not_empty(std::size_t guaranteed_filled_size, TimerWheel &wheel,
+                 TimerWheel::time_point deadline, CancellationToken token = {});
+  std::shared_ptr<AwaiterNotEmpty>
+  wait_not_empty(std::size_t guaranteed_filled_size, CancellationToken token);
+  /// For parsers: resumed once at least more_size bytes past mark() are
+  /// ready, so a partial message is not parsed again on every write.
+  std::shared_ptr<AwaiterNotEmpty> wait_unparsed(std::size_t more_size);
+  std::shared_ptr<AwaiterNotEmpty>
+  wait_unparsed(std::size_t more_size, TimerWheel &wheel,
+                TimerWheel::time_point deadline, CancellationToken token = {});
+  /// For writers: offset is a write_offset() taken after writing a message.
+  std::shared_ptr<AwaiterConsumed> wait_consumed(std::uint64_t offset);
 
   std::size_t woken_up() const noexcept;
   std::size_t woken_up_skipped() const noexcept;
 
   RingBufferCoro(std::size_t size, std::size_t low_watermark,
-                 std::size_t high_watermark);
-
-  std::queue<std::weak_ptr<AwaiterNotFull>> waiting_not_full_;
-  std::queue<std::weak_ptr<AwaiterNotEmpty>> waiting_not_empty_;
+                 std::size_t high_watermark,
+                 RingStorage storage = RingStorage::mirrored);
+  ~RingBufferCoro();
+
+  // lists and not queues, awaiters leave them on timeout or cancel
+  std::list<std::weak_ptr<AwaiterNotFull>> waiting_not_full_;
+  std::list<std::weak_ptr<AwaiterNotEmpty>> waiting_not_empty_;
+  // min heap by offset, commit wakes up waiters in offset order
+  std::priority_queue<WaitingConsumed, std::vector<WaitingConsumed>,
+                      std::greater<>>
+      waiting_consumed_;
+  // selectors stay registered across waits, see RingSelector
+  std::vector<std::pair<RingSelector *, std::size_t>> selecting_not_full_;
+  std::vector<std::pair<RingSelector *, std::size_t>> selecting_not_empty_;
   int woken_up_{};
   int woken_up_skipped_{};
 };
@@ -110,8 +209,9 @@ struct RingBuffer : public RingBufferCoro {
   }
 
   RingBuffer(std::size_t size, std::size_t low_watermark,
-             std::size_t high_watermark)
-      : RingBufferCoro(size, low_watermark, high_watermark) {}
+             std::size_t high_watermark,
+             RingStorage storage = RingStorage::mirrored)
+      : RingBufferCoro(size, low_watermark, high_watermark, storage) {}
 };
 
 } // namespace am
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "ringbufferbase.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+namespace am {
+
+namespace detail {
+
+template <typename T> inline T to_little_endian(T value) {
+  if constexpr (std::is_integral_v<T> && sizeof(T) > 1 &&
+                std::endian::native == std::endian::big) {
+    using U = std::make_unsigned_t<T>;
+    U v = static_cast<U>(value);
+    U res = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      res = static_cast<U>((res << 8) | (v & 0xff));
+      v = static_cast<U>(v >> 8);
+    }
+    return static_cast<T>(res);
+  } else {
+    return value;
+  }
+}
+
+} // namespace detail
+
+/// Encodes one message into the nonfilled sequence through the linear view.
+/**
+ * Fields are written straight into ring memory, the mirrored mapping makes
+ * the whole nonfilled sequence contiguous. Nothing is visible to readers
+ * until done(), which calls consume once for the whole message.
+ */
+struct RingWriter {
+  explicit RingWriter(RingBufferBase &ring)
+      : RingWriter(ring, ring.ready_write_size()) {}
+  RingWriter(RingBufferBase &ring, std::size_t max_size)
+      : ring_(ring)
+      , span_(ring.prepared_linear_span(static_cast<int>(max_size))) {}
+
+  /// Integral types are stored little-endian, other types as is.
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void write(const T &value) {
+    check(sizeof(T));
+    auto v = detail::to_little_endian(value);
+    std::memcpy(span_.data() + pos_, &v, sizeof(T));
+    pos_ += sizeof(T);
+  }
+
+  void write_varint(std::uint64_t value) {
+    check(varint_size(value));
+    auto *p = span_.data() + pos_;
+    while (value >= 0x80) {
+      *p++ = static_cast<char>(value | 0x80);
+      value >>= 7;
+    }
+    *p++ = static_cast<char>(value);
+    pos_ = p - span_.data();
+  }
+
+  void write_zigzag(std::int64_t value) {
+    write_varint((static_cast<std::uint64_t>(value) << 1) ^
+                 static_cast<std::uint64_t>(value >> 63));
+  }
+
+  void write_bytes(const void *data, std::size_t len) {
+    check(len);
+    std::memcpy(span_.data() + pos_, data, len);
+    pos_ += len;
+  }
+
+  /// Varint length prefix followed by the bytes.
+  void write_string(std::string_view str) {
+    check(varint_size(str.size()) + str.size());
+    write_varint(str.size());
+    write_bytes(str.data(), str.size());
+  }
+
+  std::size_t position() const { return pos_; }
+  std::size_t remaining() const { return span_.size() - pos_; }
+
+  /// Makes everything written so far readable.
+  void done() {
+    ring_.consume(pos_);
+    span_ = span_.subspan(pos_);
+    pos_ = 0;
+  }
+
+  /// Drops fields written since the last done(), e.g. after a throw.
+  void rollback() { pos_ = 0; }
+
+  static std::size_t varint_size(std::uint64_t value) {
+    return static_cast<std::size_t>(std::bit_width(value | 1) + 6) / 7;
+  }
+
+private:
+  void check(std::size_t len) const {
+    if (len > span_.size() - pos_) {
+      throw std::runtime_error("bad state");
+    }
+  }
+
+  RingBufferBase &ring_;
+  std::span<char> span_;
+  std::size_t pos_{};
+};
+
+/// Decodes messages from the filled sequence through the linear view.
+/**
+ * Strings and bytes are returned as views into ring memory, they stay valid
+ * until done() commits them. done() calls commit once for everything read.
+ */
+struct RingReader {
+  explicit RingReader(RingBufferBase &ring)
+      : RingReader(ring, ring.ready_size()) {}
+  RingReader(RingBufferBase &ring, std::size_t max_size)
+      : ring_(ring)
+      , span_(ring.peek_linear_span(static_cast<int>(max_size))) {}
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  T read() {
+    check(sizeof(T));
+    T value;
+    std::memcpy(&value, span_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return detail::to_little_endian(value);
+  }
+
+  std::uint64_t read_varint() {
+    std::uint64_t value = 0;
+    auto *p = span_.data() + pos_;
+    auto *end = span_.data() + span_.size();
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (p == end) {
+        throw std::runtime_error("bad state");
+      }
+      auto byte = static_cast<std::uint8_t>(*p++);
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        pos_ = p - span_.data();
+        return value;
+      }
+    }
+    throw std::runtime_error("bad state");
+  }
+
+  std::int64_t read_zigzag() {
+    auto v = read_varint();
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+  }
+
+  std::string_view read_bytes(std::size_t len) {
+    check(len);
+    std::string_view res(span_.data() + pos_, len);
+    pos_ += len;
+    return res;
+  }
+
+  std::string_view read_string() {
+    auto start = pos_;
+    auto len = read_varint();
+    if (len > span_.size() - pos_) {
+      pos_ = start;
+      throw std::runtime_error("bad state");
+    }
+    return read_bytes(len);
+  }
+
+  std::size_t position() const { return pos_; }
+  std::size_t remaining() const { return span_.size() - pos_; }
+
+  /// Releases everything read so far back to writers.
+  void done() {
+    ring_.commit(pos_);
+    span_ = span_.subspan(pos_);
+    pos_ = 0;
+  }
+
+  /// Rereads from the last done(), e.g. after a throw.
+  void rollback() { pos_ = 0; }
+
+private:
+  void check(std::size_t len) const {
+    if (len > span_.size() - pos_) {
+      throw std::runtime_error("bad state");
+    }
+  }
+
+  RingBufferBase &ring_;
+  std::span<char> span_;
+  std::size_t pos_{};
+};
+
+} // namespace am
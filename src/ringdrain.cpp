@@ -0,0 +1,118 @@
+#include "ringdrain.hpp"
+
+#include "ringbufferbase-system.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__APPLE__) || defined(__linux__)
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace am {
+
+#if defined(__APPLE__) || defined(__linux__)
+
+int open_direct(const char *path) {
+  int flags = O_WRONLY | O_CREAT;
+#  if defined(O_DIRECT)
+  int fd = ::open(path, flags | O_DIRECT, 0644);
+  if (fd != -1 || errno != EINVAL) {
+    return fd;
+  }
+  // tmpfs and friends
+#  endif
+  int fd_cached = ::open(path, flags, 0644);
+#  if defined(__APPLE__)
+  if (fd_cached != -1) {
+    fcntl(fd_cached, F_NOCACHE, 1);
+  }
+#  endif
+  return fd_cached;
+}
+
+DirectFileDrain::DirectFileDrain(RingBufferBase &ring, int fd,
+                                 std::uint64_t file_offset)
+    : ring_(ring)
+    , fd_(fd)
+    , offset_(file_offset)
+    , file_size_(file_offset)
+    , page_size_(system_page_size()) {
+  // whole pages are written straight from ring memory, past the filled
+  // sequence too, compact memory is neither aligned nor mapped past its end
+  if (!ring.mirrored()) {
+    throw std::runtime_error("bad state");
+  }
+  // O_DIRECT fails every write at an unaligned offset
+  if (file_offset % page_size_ != 0) {
+    throw std::runtime_error("bad state");
+  }
+}
+
+std::int64_t DirectFileDrain::write_pages(const char *data, std::size_t len) {
+  std::size_t written = 0;
+  while (written < len) {
+    auto res = ::pwrite(fd_, data + written, len - written,
+                        static_cast<off_t>(offset_ + written));
+    if (res == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    written += res;
+  }
+  return static_cast<std::int64_t>(written);
+}
+
+std::int64_t DirectFileDrain::drain() {
+  auto *start = ring_.peek_linear_span(0).data();
+  if (reinterpret_cast<std::uintptr_t>(start) % page_size_ != 0) {
+    throw std::runtime_error("bad state");
+  }
+  auto len = ring_.ready_size() & ~(page_size_ - 1);
+  if (len == 0) {
+    return 0;
+  }
+  auto span = ring_.peek_linear_span(static_cast<int>(len));
+  auto res = write_pages(span.data(), len);
+  if (res == -1) {
+    return -1;
+  }
+  offset_ += len;
+  if (file_size_ < offset_) {
+    file_size_ = offset_;
+  }
+  ring_.commit(len);
+  return res;
+}
+
+std::int64_t DirectFileDrain::flush() {
+  auto res = drain();
+  if (res == -1) {
+    return -1;
+  }
+  auto tail = ring_.ready_size();
+  if (tail == 0) {
+    return res;
+  }
+  // the rest of the page is nonfilled ring memory, mapped and writable
+  auto span = ring_.peek_linear_span(static_cast<int>(tail));
+  if (write_pages(span.data(), page_size_) == -1) {
+    return -1;
+  }
+  file_size_ = offset_ + tail;
+  if (::ftruncate(fd_, static_cast<off_t>(file_size_)) == -1) {
+    return -1;
+  }
+  return res + static_cast<std::int64_t>(tail);
+}
+
+std::uint64_t DirectFileDrain::file_size() const { return file_size_; }
+
+#endif
+
+} // namespace am
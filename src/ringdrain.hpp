@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ringbufferbase.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace am {
+
+#if defined(__APPLE__) || defined(__linux__)
+
+/// Opens path for writing with O_DIRECT (F_NOCACHE on macOS), falls back to
+/// a cached fd on file systems which don't support it. Returns -1 on error.
+int open_direct(const char *path);
+
+/// Writes the filled sequence of a mirrored ring straight to a file.
+/**
+ * Ring memory is page aligned and the mirror makes any run of pages
+ * contiguous, so whole pages go to pwrite without a staging copy, which
+ * satisfies O_DIRECT alignment. Pages are committed once written. The
+ * unaligned tail stays in the ring until flush().
+ *
+ * The drain has to be the only reader of the ring, the start of the
+ * filled sequence must stay page aligned. Compact rings and file offsets
+ * which are not page aligned are rejected.
+ */
+struct DirectFileDrain {
+  DirectFileDrain(RingBufferBase &ring, int fd,
+                  std::uint64_t file_offset = 0);
+
+  /// Writes and commits every whole page of the filled sequence. Returns
+  /// bytes written or -1 with errno set.
+  std::int64_t drain();
+
+  /// Writes the tail too, padded to a whole page, and truncates the file to
+  /// its real length. The tail is not committed, next drain writes its page
+  /// again together with the new bytes.
+  std::int64_t flush();
+
+  std::uint64_t file_size() const;
+
+private:
+  std::int64_t write_pages(const char *data, std::size_t len);
+
+  RingBufferBase &ring_;
+  int fd_;
+  std::uint64_t offset_;
+  std::uint64_t file_size_;
+  std::size_t page_size_;
+};
+
+#endif
+
+} // namespace am
@@ -0,0 +1,236 @@
+#include "ringlog.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace am {
+
+namespace {
+
+std::atomic<std::size_t> ring_log_ids{};
+
+template <typename T> T get(const char *&p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return value;
+}
+
+} // namespace
+
+RingLog::ThreadRing::ThreadRing(std::size_t size)
+    : data_(size, RingStorage::mirrored) {}
+
+RingLog::RingLog(std::ostream &out, std::size_t ring_size)
+    : out_(out)
+    , ring_size_(ring_size)
+    , id_(ring_log_ids++)
+    , start_ticks_(timestamp())
+    , start_ns_(clock::now().time_since_epoch().count()) {}
+
+RingLog::~RingLog() {
+  stop();
+  drain();
+}
+
+std::uint32_t RingLog::register_format(std::string_view format) {
+  std::lock_guard lock(registry_mutex_);
+  formats_.emplace_back(format);
+  return static_cast<std::uint32_t>(formats_.size() - 1);
+}
+
+RingLog::ThreadRing &RingLog::this_thread_ring() {
+  struct Entry {
+    // ids and not addresses, a new log can reuse the address of a dead one
+    std::size_t id_;
+    // the log owns its rings, expired once it is destroyed
+    std::weak_ptr<ThreadRing> owner_;
+    ThreadRing *ring_;
+  };
+  struct ThreadRings {
+    ~ThreadRings() {
+      for (auto &entry : entries_) {
+        if (auto ring = entry.owner_.lock()) {
+          ring->retired_.store(true, std::memory_order_release);
+        }
+      }
+    }
+
+    std::vector<Entry> entries_;
+  };
+  thread_local ThreadRings thread_rings;
+  auto &entries = thread_rings.entries_;
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->id_ == id_) {
+      return *it->ring_;
+    }
+    if (it->owner_.expired()) {
+      it = entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  auto ring = std::make_shared<ThreadRing>(ring_size_);
+  {
+    std::lock_guard lock(registry_mutex_);
+    rings_.push_back(ring);
+  }
+  entries.push_back({id_, ring, ring.get()});
+  return *ring;
+}
+
+std::size_t RingLog::drain() {
+  std::lock_guard drain_lock(drain_mutex_);
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  {
+    std::lock_guard lock(registry_mutex_);
+    rings = rings_;
+  }
+#if defined(RBC_LOG_TSC)
+  auto ticks = timestamp() - start_ticks_;
+  auto ns = clock::now().time_since_epoch().count() - start_ns_;
+  if (ticks > 0) {
+    ns_per_tick_ = static_cast<double>(ns) / static_cast<double>(ticks);
+  }
+#endif
+  batch_.clear();
+  std::vector<std::shared_ptr<ThreadRing>> drained;
+  for (auto &thread_ring : rings) {
+    // nothing is logged to a retired ring after the flag is set
+    auto retired = thread_ring->retired_.load(std::memory_order_acquire);
+    auto read_pos = thread_ring->read_pos_.load(std::memory_order_relaxed);
+    auto write_pos = thread_ring->write_pos_.load(std::memory_order_acquire);
+    auto &data = thread_ring->data_;
+    const auto *p = &data.at(read_pos % data.size());
+    batch_.insert(batch_.end(), p, p + (write_pos - read_pos));
+    thread_ring->read_pos_.store(write_pos, std::memory_order_release);
+    if (retired) {
+      drained.push_back(thread_ring);
+    }
+  }
+  if (!drained.empty()) {
+    std::lock_guard lock(registry_mutex_);
+    std::erase_if(rings_, [&drained](const auto &ring) {
+      return std::find(drained.begin(), drained.end(), ring) != drained.end();
+    });
+  }
+  return format(batch_);
+}
+
+std::size_t RingLog::format(std::span<const char> records) {
+  struct Record {
+    std::int64_t timestamp_;
+    const char *p_;
+  };
+  std::vector<Record> sorted;
+  for (std::size_t pos = 0; pos < records.size();) {
+    const char *p = records.data() + pos;
+    std::uint32_t len = 0;
+    std::memcpy(&len, p, sizeof(len));
+    std::int64_t timestamp = 0;
+    std::memcpy(&timestamp, p + 2 * sizeof(std::uint32_t), sizeof(timestamp));
+    sorted.push_back({timestamp, p});
+    pos += len;
+  }
+  // every ring is ordered, interleave threads by time
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Record &a, const Record &b) {
+                     return a.timestamp_ < b.timestamp_;
+                   });
+
+  std::lock_guard lock(registry_mutex_);
+  for (const auto &record : sorted) {
+    const char *p = record.p_;
+    auto len = get<std::uint32_t>(p);
+    const char *end = record.p_ + len;
+    auto format_id = get<std::uint32_t>(p);
+    auto timestamp = get<std::int64_t>(p);
+    std::string_view format = formats_[format_id];
+
+    out_ << to_nanoseconds(timestamp) << ' ';
+    while (!format.empty()) {
+      auto placeholder = format.find("{}");
+      out_ << format.substr(0, placeholder);
+      if (placeholder == std::string_view::npos) {
+        break;
+      }
+      format.remove_prefix(placeholder + 2);
+      if (p == end) {
+        out_ << "{}";
+        continue;
+      }
+      switch (get<Tag>(p)) {
+      case Tag::i64:
+        out_ << get<std::int64_t>(p);
+        break;
+      case Tag::u64:
+        out_ << get<std::uint64_t>(p);
+        break;
+      case Tag::f64:
+        out_ << get<double>(p);
+        break;
+      case Tag::str: {
+        auto str_len = get<std::uint32_t>(p);
+        out_ << std::string_view(p, str_len);
+        p += str_len;
+        break;
+      }
+      }
+    }
+    out_ << '\n';
+  }
+  return sorted.size();
+}
+
+std::int64_t RingLog::to_nanoseconds(std::int64_t timestamp) const {
+#if defined(RBC_LOG_TSC)
+  return start_ns_ + static_cast<std::int64_t>(
+                         static_cast<double>(timestamp - start_ticks_) *
+                         ns_per_tick_);
+#else
+  return timestamp;
+#endif
+}
+
+void RingLog::start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  drainer_ = std::thread([this] {
+    while (running_.load(std::memory_order_relaxed)) {
+      if (drain() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  });
+}
+
+void RingLog::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  drainer_.join();
+}
+
+std::size_t RingLog::dropped() const {
+  return dropped_.load(std::memory_order_relaxed);
+}
+
+std::size_t RingLog::thread_rings() {
+  std::lock_guard lock(registry_mutex_);
+  return rings_.size();
+}
+
+} // namespace am
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "ringbufferbase.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#  define RBC_LOG_TSC 1
+#endif
+
+namespace am {
+
+/// Binary logger, formatting happens off the hot path.
+/**
+ * log() writes a compact record into a ring owned by the calling thread:
+ * length, format id, timestamp and the raw arguments, each prefixed by a
+ * type tag. Timestamps are TSC ticks on x86-64, converted to steady clock
+ * nanoseconds when formatting, and steady clock nanoseconds elsewhere.
+ * Thread rings are single producer single consumer queues over mirrored
+ * memory, log() never locks or allocates once the thread has its ring. A
+ * background thread copies records out of all rings, formats them and
+ * writes them to the output stream. When a ring is full the record is
+ * dropped and counted. Rings are released with the log, and the ring of
+ * an exited thread once it is drained.
+ */
+struct RingLog {
+  using clock = std::chrono::steady_clock;
+
+  enum class Tag : char { i64, u64, f64, str };
+
+  explicit RingLog(std::ostream &out, std::size_t ring_size = 1 << 16);
+  ~RingLog();
+  RingLog(const RingLog &) = delete;
+  RingLog(RingLog &&) = delete;
+  RingLog &operator=(const RingLog &) = delete;
+  RingLog &operator=(RingLog &&) = delete;
+
+  /// Format with {} placeholders, register them before logging.
+  std::uint32_t register_format(std::string_view format);
+
+  template <typename... Args>
+  bool log(std::uint32_t format_id, const Args &...args) {
+    auto &thread_ring = this_thread_ring();
+    std::uint32_t len = header_size + (arg_size(args) + ... + 0);
+    auto write_pos = thread_ring.write_pos_.load(std::memory_order_relaxed);
+    auto read_pos = thread_ring.read_pos_.load(std::memory_order_acquire);
+    auto size = thread_ring.data_.size();
+    if (size - (write_pos - read_pos) < len) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    std::int64_t now = timestamp();
+    // the mirrored mapping keeps records crossing the end linear
+    LinearSink sink{&thread_ring.data_.at(write_pos % size)};
+    sink.put(&len, sizeof(len));
+    sink.put(&format_id, sizeof(format_id));
+    sink.put(&now, sizeof(now));
+    (put_arg(sink, args), ...);
+    thread_ring.write_pos_.store(write_pos + len, std::memory_order_release);
+    return true;
+  }
+
+  static std::int64_t timestamp() {
+#if defined(RBC_LOG_TSC)
+    return static_cast<std::int64_t>(__rdtsc());
+#else
+    return clock::now().time_since_epoch().count();
+#endif
+  }
+
+  /// Formats everything logged so far, returns number of records.
+  std::size_t drain();
+
+  void start();
+  void stop();
+
+  std::size_t dropped() const;
+  /// Rings of threads which logged and were not released yet.
+  std::size_t thread_rings();
+
+private:
+  struct ThreadRing {
+    explicit ThreadRing(std::size_t size);
+
+    LinnearArray data_;
+    // stream offsets, write_pos_ is stored by the owning thread only and
+    // read_pos_ by the drainer only
+    alignas(64) std::atomic<std::uint64_t> write_pos_{};
+    alignas(64) std::atomic<std::uint64_t> read_pos_{};
+    // set when the owning thread exits
+    std::atomic<bool> retired_{};
+  };
+
+  static constexpr std::uint32_t header_size =
+      sizeof(std::uint32_t) + sizeof(std::uint32_t) + sizeof(std::int64_t);
+
+  ThreadRing &this_thread_ring();
+
+  /// Fixed size copies are inlined.
+  struct LinearSink {
+    void put(const void *data, std::size_t len) {
+      std::memcpy(p_, data, len);
+      p_ += len;
+    }
+
+    char *p_;
+  };
+
+  template <typename T> static std::uint32_t arg_size(const T &arg) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      return 1 + 8;
+    } else {
+      return 1 + sizeof(std::uint32_t) +
+             static_cast<std::uint32_t>(std::string_view(arg).size());
+    }
+  }
+
+  template <typename Sink, typename T>
+  static void put_arg(Sink &sink, const T &arg) {
+    if constexpr (std::is_floating_point_v<T>) {
+      Tag tag = Tag::f64;
+      double v = arg;
+      sink.put(&tag, 1);
+      sink.put(&v, sizeof(v));
+    } else if constexpr (std::is_signed_v<T>) {
+      Tag tag = Tag::i64;
+      std::int64_t v = arg;
+      sink.put(&tag, 1);
+      sink.put(&v, sizeof(v));
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      Tag tag = Tag::u64;
+      std::uint64_t v = arg;
+      sink.put(&tag, 1);
+      sink.put(&v, sizeof(v));
+    } else {
+      Tag tag = Tag::str;
+      std::string_view v(arg);
+      auto len = static_cast<std::uint32_t>(v.size());
+      sink.put(&tag, 1);
+      sink.put(&len, sizeof(len));
+      sink.put(v.data(), v.size());
+    }
+  }
+
+  std::size_t format(std::span<const char> records);
+  std::int64_t to_nanoseconds(std::int64_t timestamp) const;
+
+  std::ostream &out_;
+  std::size_t ring_size_;
+  std::size_t id_;
+  // pairs of timestamp() and steady clock, to convert ticks when formatting
+  std::int64_t start_ticks_;
+  std::int64_t start_ns_;
+  double ns_per_tick_{1.0};
+  std::mutex registry_mutex_;
+  std::mutex drain_mutex_;
+  std::vector<std::shared_ptr<ThreadRing>> rings_;
+  std::vector<std::string> formats_;
+  std::vector<char> batch_;
+  std::atomic<std::size_t> dropped_{};
+  std::atomic<bool> running_{};
+  std::thread drainer_;
+};
+
+} // namespace am
@@ -0,0 +1,118 @@
+#include "ringselector.hpp"
+
+#include "ringbuffercoro.hpp"
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace am {
+
+RingSelector::Awaiter::Awaiter(RingSelector &selector)
+    : selector_(selector) {}
+
+bool RingSelector::Awaiter::await_ready() {
+  auto &sel = selector_;
+  for (auto index : sel.reported_) {
+    sel.queue_if_ready(index);
+  }
+  sel.reported_.clear();
+  // entries queued while the coroutine was running could be drained by it
+  std::erase_if(sel.ready_, [&sel](std::size_t index) {
+    if (sel.is_ready(index)) {
+      return false;
+    }
+    sel.entries_[index].queued_ = false;
+    return true;
+  });
+  return !sel.ready_.empty();
+}
+
+void RingSelector::Awaiter::await_suspend(std::coroutine_handle<> h) {
+  selector_.coro_ = h;
+}
+
+const std::vector<std::size_t> &RingSelector::Awaiter::await_resume() {
+  auto &sel = selector_;
+  sel.coro_ = {};
+  for (auto index : sel.ready_) {
+    sel.entries_[index].queued_ = false;
+    // a ring could have been drained between notify and resume
+    if (sel.is_ready(index)) {
+      sel.reported_.push_back(index);
+    }
+  }
+  sel.ready_.clear();
+  return sel.reported_;
+}
+
+RingSelector::~RingSelector() {
+  for (std::size_t i = 0; i < entries_.size(); i++) {
+    remove(i);
+  }
+}
+
+std::size_t RingSelector::add(RingBufferCoro &ring, Interest interest,
+                              std::size_t min_size) {
+  auto index = entries_.size();
+  entries_.push_back(Entry{&ring, interest, min_size, false});
+  auto &watchers = interest == Interest::readable ? ring.selecting_not_empty_
+                                                  : ring.selecting_not_full_;
+  watchers.emplace_back(this, index);
+  queue_if_ready(index);
+  return index;
+}
+
+void RingSelector::remove(std::size_t index) {
+  auto &entry = entries_[index];
+  if (!entry.ring_) {
+    return;
+  }
+  auto &watchers = entry.interest_ == Interest::readable
+                       ? entry.ring_->selecting_not_empty_
+                       : entry.ring_->selecting_not_full_;
+  std::erase(watchers, std::pair<RingSelector *, std::size_t>(this, index));
+  entry.ring_ = nullptr;
+  std::erase(ready_, index);
+  std::erase(reported_, index);
+}
+
+RingSelector::Awaiter RingSelector::wait() { return Awaiter(*this); }
+
+bool RingSelector::is_ready(std::size_t index) const {
+  auto &entry = entries_[index];
+  if (!entry.ring_) {
+    return false;
+  }
+  if (entry.interest_ == Interest::readable) {
+    return entry.ring_->ready_size() >= entry.min_size_;
+  }
+  return entry.ring_->ready_write_size() >= entry.min_size_;
+}
+
+void RingSelector::notify(std::size_t index) {
+  queue_if_ready(index);
+  if (coro_ && !ready_.empty()) {
+    auto coro = coro_;
+    coro_ = {};
+    coro();
+  }
+}
+
+void RingSelector::detach(std::size_t index) noexcept {
+  entries_[index].ring_ = nullptr;
+  std::erase(ready_, index);
+  std::erase(reported_, index);
+}
+
+void RingSelector::queue_if_ready(std::size_t index) {
+  auto &entry = entries_[index];
+  if (!entry.queued_ && is_ready(index)) {
+    entry.queued_ = true;
+    ready_.push_back(index);
+  }
+}
+
+} // namespace am
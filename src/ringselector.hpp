@@ -0,0 +1,70 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <vector>
+
+namespace am {
+
+struct RingBufferCoro;
+
+/// Waits on a set of rings at once.
+/**
+ * Every ring is registered once with add() and stays registered across
+ * waits: the ring notifies the selector from its commit/consume hooks, the
+ * selector keeps a list of entries which became ready and resumes the
+ * waiting coroutine once. Entries reported by the previous wait are
+ * rechecked on the next one, so rings which were not drained fully are
+ * reported again without a new notification.
+ */
+struct RingSelector {
+  enum class Interest { readable, writable };
+
+  struct Awaiter {
+    explicit Awaiter(RingSelector &selector);
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    const std::vector<std::size_t> &await_resume();
+
+    RingSelector &selector_;
+  };
+
+  RingSelector() = default;
+  ~RingSelector();
+  RingSelector(const RingSelector &) = delete;
+  RingSelector(RingSelector &&) = delete;
+  RingSelector &operator=(const RingSelector &) = delete;
+  RingSelector &operator=(RingSelector &&) = delete;
+
+  /// Readable means at least min_size bytes are ready to read, writable
+  /// means at least min_size bytes are ready to write. Returns the index
+  /// reported by wait().
+  std::size_t add(RingBufferCoro &ring, Interest interest,
+                  std::size_t min_size);
+  void remove(std::size_t index);
+
+  /// Resumes with the indexes of ready entries.
+  Awaiter wait();
+
+  bool is_ready(std::size_t index) const;
+
+  void notify(std::size_t index);
+  void detach(std::size_t index) noexcept;
+
+private:
+  struct Entry {
+    RingBufferCoro *ring_;
+    Interest interest_;
+    std::size_t min_size_;
+    bool queued_;
+  };
+
+  void queue_if_ready(std::size_t index);
+
+  std::vector<Entry> entries_;
+  std::vector<std::size_t> ready_;
+  std::vector<std::size_t> reported_;
+  std::coroutine_handle<> coro_{};
+};
+
+} // namespace am
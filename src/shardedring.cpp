@@ -0,0 +1,163 @@
+#include "shardedring.hpp"
+
+#include "ringbufferbase-system.hpp"
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace am {
+
+ShardedRing::Shard::Shard(std::size_t size)
+    : ring_(size, 0, size) {}
+
+ShardedRing::AwaiterShardNotEmpty::AwaiterShardNotEmpty(
+    std::size_t shard, ShardedRing &sharded_ring)
+    : sharded_ring_(sharded_ring)
+    , shard_(shard) {}
+
+bool ShardedRing::AwaiterShardNotEmpty::await_ready() {
+  return sharded_ring_.ready_size(shard_) > 0;
+}
+
+bool ShardedRing::AwaiterShardNotEmpty::await_suspend(
+    std::coroutine_handle<> h) {
+  auto &ring = sharded_ring_;
+  auto &shard = *ring.shards_[shard_];
+  {
+    std::lock_guard lock(shard.mutex_);
+    // a push could have happened after await_ready
+    if (!shard.ring_.empty()) {
+      return false;
+    }
+    coro_ = h;
+    shard.waiting_.emplace_back(shared_from_this());
+  }
+  ring.waiting_.fetch_add(1, std::memory_order_seq_cst);
+  // a push into another shard could have missed the waiter
+  bool records = false;
+  for (std::size_t i = 1; !records && i < ring.shards_.size(); i++) {
+    records = ring.ready_size((shard_ + i) % ring.shards_.size()) > 0;
+  }
+  if (!records) {
+    return true;
+  }
+  std::lock_guard lock(shard.mutex_);
+  auto it = std::find_if(shard.waiting_.begin(), shard.waiting_.end(),
+                         [this](const auto &waiter) {
+                           return waiter.lock().get() == this;
+                         });
+  if (it == shard.waiting_.end()) {
+    // popped by a push, which resumes the coroutine
+    return true;
+  }
+  shard.waiting_.erase(it);
+  ring.waiting_.fetch_sub(1, std::memory_order_relaxed);
+  return false;
+}
+
+void ShardedRing::AwaiterShardNotEmpty::await_resume() {}
+
+ShardedRing::ShardedRing(std::size_t shard_count, std::size_t shard_size) {
+  shards_.reserve(shard_count);
+  for (std::size_t i = 0; i < shard_count; i++) {
+    shards_.push_back(std::make_unique<Shard>(shard_size));
+  }
+}
+
+std::size_t ShardedRing::shard_count() const noexcept { return shards_.size(); }
+
+std::size_t ShardedRing::shard_for_key(std::size_t key) const noexcept {
+  return key % shards_.size();
+}
+
+std::size_t ShardedRing::shard_for_this_cpu() const noexcept {
+  return current_cpu() % shards_.size();
+}
+
+bool ShardedRing::try_push(std::size_t shard_index, bytes_view record) {
+  auto &shard = *shards_[shard_index];
+  std::shared_ptr<AwaiterShardNotEmpty> waiter{};
+  {
+    std::lock_guard lock(shard.mutex_);
+    int len = static_cast<int>(record.size());
+    auto framed_size = sizeof(len) + record.size();
+    if (shard.ring_.ready_write_size() < framed_size) {
+      return false;
+    }
+    auto span = shard.ring_.prepared_linear_span(static_cast<int>(framed_size));
+    std::memcpy(span.data(), &len, sizeof(len));
+    std::memcpy(span.data() + sizeof(len), record.data(), record.size());
+    shard.ring_.consume(framed_size);
+    waiter = pop_waiter(shard);
+  }
+  // consumers parked on other shards steal the record
+  for (std::size_t i = 1; !waiter && i < shards_.size() &&
+                          waiting_.load(std::memory_order_seq_cst) > 0;
+       i++) {
+    auto &other = *shards_[(shard_index + i) % shards_.size()];
+    std::lock_guard lock(other.mutex_);
+    waiter = pop_waiter(other);
+  }
+  if (waiter) {
+    waiter->coro_.resume();
+  }
+  return true;
+}
+
+std::shared_ptr<ShardedRing::AwaiterShardNotEmpty>
+ShardedRing::pop_waiter(Shard &shard) {
+  while (!shard.waiting_.empty()) {
+    auto awaiter = shard.waiting_.front().lock();
+    shard.waiting_.pop_front();
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+    if (awaiter) {
+      return awaiter;
+    }
+    // the coroutine was destroyed while waiting
+  }
+  return nullptr;
+}
+
+std::size_t ShardedRing::take(std::size_t shard_index, std::size_t max_records,
+                              std::vector<char> &out) {
+  auto &shard = *shards_[shard_index];
+  std::lock_guard lock(shard.mutex_);
+  auto &ring = shard.ring_;
+  if (ring.empty()) {
+    return 0;
+  }
+  auto span = ring.peek_linear_span(static_cast<int>(ring.ready_size()));
+  std::size_t records = 0;
+  std::size_t pos = 0;
+  while (records < max_records && pos < span.size()) {
+    int len = 0;
+    std::memcpy(&len, span.data() + pos, sizeof(len));
+    pos += sizeof(len) + len;
+    records++;
+  }
+  out.insert(out.end(), span.data(), span.data() + pos);
+  ring.commit(pos);
+  return records;
+}
+
+std::shared_ptr<ShardedRing::AwaiterShardNotEmpty>
+ShardedRing::wait_not_empty(std::size_t shard) {
+  return std::make_shared<AwaiterShardNotEmpty>(shard, *this);
+}
+
+std::size_t ShardedRing::ready_size(std::size_t shard_index) {
+  auto &shard = *shards_[shard_index];
+  std::lock_guard lock(shard.mutex_);
+  return shard.ring_.ready_size();
+}
+
+std::size_t ShardedRing::stolen() const noexcept {
+  return stolen_.load(std::memory_order_relaxed);
+}
+
+} // namespace am
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ringbuffercoro.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace am {
+
+/// Set of rings, one per core, for fan-in of small records into a pool of
+/// consumer threads.
+/**
+ * Records are framed with a 4 byte length. Every shard has its own mutex, so
+ * producers on different cores don't contend with each other. Consumers
+ * drain their home shard first and steal a batch from the other shards when
+ * it is empty.
+ */
+struct ShardedRing {
+  using shard_type = RingBuffer<std::span<const char>, std::span<char>>;
+
+  /// Resumed on the pushing thread by the next push into the shard, or by
+  /// a push into another shard nobody waits on, so the consumer can steal.
+  struct AwaiterShardNotEmpty
+      : std::enable_shared_from_this<AwaiterShardNotEmpty> {
+    AwaiterShardNotEmpty(std::size_t shard, ShardedRing &sharded_ring);
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> h);
+    void await_resume();
+    AwaiterRef<AwaiterShardNotEmpty> operator co_await() & { return {*this}; }
+
+    ShardedRing &sharded_ring_;
+    std::size_t shard_;
+    std::coroutine_handle<> coro_{};
+  };
+
+  ShardedRing(std::size_t shard_count, std::size_t shard_size);
+
+  std::size_t shard_count() const noexcept;
+  std::size_t shard_for_key(std::size_t key) const noexcept;
+  std::size_t shard_for_this_cpu() const noexcept;
+
+  /// Appends one record, returns false if the shard has no room for it.
+  bool try_push(std::size_t shard, bytes_view record);
+
+  /// Takes up to max_records records from home, or steals them from the
+  /// next nonempty shard, and calls f with each one outside of any lock.
+  template <typename F>
+  std::size_t drain(std::size_t home, std::size_t max_records, F &&f) {
+    // f can push and resume a consumer which drains on this thread, a
+    // nested drain takes its own buffer
+    thread_local std::vector<char> spare;
+    auto batch = std::move(spare);
+    batch.clear();
+    auto taken = take(home, max_records, batch);
+    for (std::size_t i = 1; taken == 0 && i < shards_.size(); i++) {
+      taken = take((home + i) % shards_.size(), max_records, batch);
+      stolen_.fetch_add(taken, std::memory_order_relaxed);
+    }
+    std::size_t pos = 0;
+    while (pos < batch.size()) {
+      int len = 0;
+      std::memcpy(&len, batch.data() + pos, sizeof(len));
+      pos += sizeof(len);
+      f(std::string_view(batch.data() + pos, len));
+      pos += len;
+    }
+    spare = std::move(batch);
+    return taken;
+  }
+
+  std::shared_ptr<AwaiterShardNotEmpty> wait_not_empty(std::size_t shard);
+
+  std::size_t ready_size(std::size_t shard);
+  std::size_t stolen() const noexcept;
+
+private:
+  struct alignas(64) Shard {
+    explicit Shard(std::size_t size);
+
+    std::mutex mutex_;
+    shard_type ring_;
+    std::deque<std::weak_ptr<AwaiterShardNotEmpty>> waiting_;
+  };
+
+  std::size_t take(std::size_t shard, std::size_t max_records,
+                   std::vector<char> &out);
+  /// Pops the oldest live waiter of the shard, the shard mutex is held.
+  std::shared_ptr<AwaiterShardNotEmpty> pop_waiter(Shard &shard);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<std::size_t> stolen_{};
+  // waiters queued on all shards, pushes only look for idle consumers on
+  // other shards when there are some. Pushes store a record then load it,
+  // waiters store it then check every shard, both seq_cst, so one of the
+  // two sees the other.
+  std::atomic<std::size_t> waiting_{};
+};
+
+} // namespace am
@@ -0,0 +1,143 @@
+#include "timerwheel.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+namespace am {
+
+TimerWheel::Timer::~Timer() { cancel(); }
+
+bool TimerWheel::Timer::armed() const noexcept { return wheel_ != nullptr; }
+
+void TimerWheel::Timer::cancel() noexcept {
+  if (wheel_) {
+    wheel_->unlink(*this);
+    on_expire_ = nullptr;
+  }
+}
+
+TimerWheel::TimerWheel(time_point now)
+    : now_(now) {}
+
+TimerWheel::~TimerWheel() {
+  for (auto &level : wheel_) {
+    for (auto &slot : level) {
+      while (slot) {
+        unlink(*slot);
+      }
+    }
+  }
+}
+
+void TimerWheel::arm(Timer &timer, time_point expires,
+                     std::function<void()> on_expire) {
+  if (timer.wheel_) {
+    timer.wheel_->unlink(timer);
+  }
+  timer.expires_ = expires;
+  timer.on_expire_ = std::move(on_expire);
+  // the slot of now_ was fired already
+  link(timer, now_ + 1);
+}
+
+void TimerWheel::advance(time_point now) {
+  while (now_ < now) {
+    if (armed_ == 0) {
+      now_ = now;
+      return;
+    }
+    // nothing happens until the next slot boundary of the lowest used level
+    std::size_t lowest = 0;
+    while (level_armed_[lowest] == 0) {
+      lowest++;
+    }
+    if (lowest > 0) {
+      auto boundary = now_ | ((time_point(1) << (slot_bits * lowest)) - 1);
+      now_ = boundary < now ? boundary : now;
+      if (now_ == now) {
+        return;
+      }
+    }
+    now_++;
+    // refill lower levels from the slot of the upper level which starts now
+    for (std::size_t level = 1; level < levels; level++) {
+      auto shift = slot_bits * level;
+      if ((now_ & ((time_point(1) << shift) - 1)) != 0) {
+        break;
+      }
+      cascade(level, (now_ >> shift) & (slots - 1));
+    }
+    auto &slot = wheel_[0][now_ & (slots - 1)];
+    while (slot) {
+      auto &timer = *slot;
+      unlink(timer);
+      // the callback can destroy the timer
+      auto on_expire = std::move(timer.on_expire_);
+      on_expire();
+    }
+  }
+}
+
+TimerWheel::time_point TimerWheel::now() const noexcept { return now_; }
+
+std::size_t TimerWheel::armed() const noexcept { return armed_; }
+
+void TimerWheel::link(Timer &timer, time_point earliest) {
+  auto expires = timer.expires_ > earliest ? timer.expires_ : earliest;
+  auto delta = expires - now_;
+  std::size_t level = 0;
+  while (level + 1 < levels &&
+         delta >= (time_point(1) << (slot_bits * (level + 1)))) {
+    level++;
+  }
+  auto max_delta = (time_point(1) << (slot_bits * levels)) - 1;
+  if (delta > max_delta) {
+    // cascaded again with the real expiry when the slot comes up
+    expires = now_ + max_delta;
+  }
+  auto &slot = wheel_[level][(expires >> (slot_bits * level)) & (slots - 1)];
+  timer.wheel_ = this;
+  timer.slot_ = &slot;
+  timer.level_ = level;
+  timer.prev_ = nullptr;
+  timer.next_ = slot;
+  if (slot) {
+    slot->prev_ = &timer;
+  }
+  slot = &timer;
+  armed_++;
+  level_armed_[level]++;
+}
+
+void TimerWheel::unlink(Timer &timer) noexcept {
+  if (timer.prev_) {
+    timer.prev_->next_ = timer.next_;
+  } else {
+    *timer.slot_ = timer.next_;
+  }
+  if (timer.next_) {
+    timer.next_->prev_ = timer.prev_;
+  }
+  timer.wheel_ = nullptr;
+  timer.slot_ = nullptr;
+  timer.prev_ = nullptr;
+  timer.next_ = nullptr;
+  armed_--;
+  level_armed_[timer.level_]--;
+}
+
+void TimerWheel::cascade(std::size_t level, std::size_t slot_index) {
+  auto *timer = wheel_[level][slot_index];
+  wheel_[level][slot_index] = nullptr;
+  while (timer) {
+    auto *next = timer->next_;
+    armed_--;
+    level_armed_[level]--;
+    // cascade runs before the slot of now_ is fired
+    link(*timer, now_);
+    timer = next;
+  }
+}
+
+} // namespace am
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace am {
+
+/// Hierarchical timer wheel driven by the caller's clock.
+/**
+ * Time is in ticks of whatever unit the caller advances it with, which
+ * makes it easy to drive from a simulated clock in tests. Four levels of
+ * 256 slots cover 2^32 ticks, timers further away are cascaded again when
+ * their slot comes up. Timers are intrusive list nodes owned by the caller:
+ * arm and cancel are O(1) and don't allocate beyond the callback.
+ */
+struct TimerWheel {
+  using time_point = std::uint64_t;
+
+  struct Timer {
+    Timer() = default;
+    ~Timer();
+    Timer(const Timer &) = delete;
+    Timer(Timer &&) = delete;
+    Timer &operator=(const Timer &) = delete;
+    Timer &operator=(Timer &&) = delete;
+
+    bool armed() const noexcept;
+    void cancel() noexcept;
+
+  private:
+    friend TimerWheel;
+
+    TimerWheel *wheel_{};
+    Timer **slot_{};
+    Timer *prev_{};
+    Timer *next_{};
+    std::size_t level_{};
+    time_point expires_{};
+    std::function<void()> on_expire_{};
+  };
+
+  explicit TimerWheel(time_point now = 0);
+  ~TimerWheel();
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel(TimerWheel &&) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+  TimerWheel &operator=(TimerWheel &&) = delete;
+
+  /// Calls on_expire once from advance() at or after expires, rearms the
+  /// timer if it is armed already.
+  void arm(Timer &timer, time_point expires, std::function<void()> on_expire);
+
+  /// Moves the clock forward and fires every timer expired on the way.
+  void advance(time_point now);
+
+  time_point now() const noexcept;
+  std::size_t armed() const noexcept;
+
+private:
+  static constexpr std::size_t levels = 4;
+  static constexpr std::size_t slot_bits = 8;
+  static constexpr std::size_t slots = 1 << slot_bits;
+
+  void link(Timer &timer, time_point earliest);
+  void unlink(Timer &timer) noexcept;
+  void cascade(std::size_t level, std::size_t slot);
+
+  std::array<std::array<Timer *, slots>, levels> wheel_{};
+  std::array<std::size_t, levels> level_armed_{};
+  time_point now_;
+  std::size_t armed_{};
+};
+
+} // namespace am
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "ringbuffercoro.hpp"
@@ -114,4 +120,340 @@ TEST_CASE("commit does not crash when waiting coroutine is destroyed", "[RingBuf
 }
 
 
+Task acked_producer(RingBufferSpan &ring, std::vector<int> &acked) {
+  for (int i = 1; i <= 3; i++) {
+    ring.memcpy_in(&i, sizeof(i));
+    std::uint64_t end = ring.write_offset();
+    auto awaiter = ring.wait_consumed(end);
+    co_await *awaiter;
+    acked.push_back(i);
+  }
+}
+
+TEST_CASE("wait_consumed resumes writer once its message is committed",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<int> acked;
+  auto producer_coro = acked_producer(ring, acked);
+  producer_coro.resume();
+  REQUIRE(ring.write_offset() == 4);
+  REQUIRE(acked.empty());
+
+  ring.commit(2);
+  REQUIRE(ring.read_offset() == 2);
+  REQUIRE(acked.empty());
+
+  ring.commit(2);
+  REQUIRE(acked == std::vector<int>{1});
+  REQUIRE(ring.write_offset() == 8);
+
+  ring.commit(4);
+  REQUIRE(acked == std::vector<int>{1, 2});
+  ring.commit(4);
+  REQUIRE(acked == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("reset resumes writers waiting for dropped bytes",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<int> acked;
+  auto producer_coro = acked_producer(ring, acked);
+  producer_coro.resume();
+  REQUIRE(acked.empty());
+
+  ring.reset();
+  REQUIRE(ring.read_offset() == 4);
+  REQUIRE(acked == std::vector<int>{1});
+  ring.reset();
+  ring.reset();
+  REQUIRE(acked == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("wait_consumed wakes up waiters in offset order",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<char> data(12);
+  ring.memcpy_in(data.data(), data.size());
+
+  std::vector<int> order;
+  auto waiter = [](RingBufferSpan &ring, std::uint64_t offset,
+                   std::vector<int> &order) -> Task {
+    auto awaiter = ring.wait_consumed(offset);
+    co_await *awaiter;
+    order.push_back(static_cast<int>(offset));
+  };
+  auto w12 = waiter(ring, 12, order);
+  auto w4 = waiter(ring, 4, order);
+  auto w8 = waiter(ring, 8, order);
+  w12.resume();
+  w4.resume();
+  w8.resume();
+  REQUIRE(order.empty());
+
+  ring.commit(9);
+  REQUIRE(order == std::vector<int>{4, 8});
+  ring.commit(3);
+  REQUIRE(order == std::vector<int>{4, 8, 12});
+  REQUIRE(ring.woken_up() == 3);
+}
+
+TEST_CASE("compact ring has exactly the requested size", "[RingBufferCoro]") {
+  RingBufferSpan ring(300, 100, 200, RingStorage::compact);
+  REQUIRE(ring.ready_write_size() == 300);
+  REQUIRE(ring.ready_size() == 0);
+}
+
+TEST_CASE("compact ring splits views at the end of the buffer",
+          "[RingBufferCoro]") {
+  RingBuffer<std::span<const char>, std::span<char>> ring(16, 4, 8, RingStorage::compact);
+  std::string filler(14, 'f');
+  ring.memcpy_in(filler.data(), filler.size());
+  ring.commit(14);
+
+  int value = 0x01020304;
+  ring.memcpy_in(&value, sizeof(value));
+  REQUIRE(ring.peek_int() == value);
+  auto data = ring.data();
+  REQUIRE(data.count() == 2);
+  REQUIRE(data.size() == sizeof(value));
+
+  auto prepared = ring.prepared();
+  REQUIRE(prepared.count() == 1);
+  REQUIRE(prepared.size() == 12);
+
+  int out = 0;
+  ring.memcpy_out(&out, sizeof(out));
+  REQUIRE(out == value);
+}
+
+TEST_CASE("compact ring linear views move wrapped data to the start",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(16, 4, 8, RingStorage::compact);
+  std::string filler(12, 'f');
+  ring.memcpy_in(filler.data(), filler.size());
+  ring.commit(12);
+  ring.memcpy_in("abcdefgh", 8);
+
+  auto span = ring.peek_linear_span(8);
+  REQUIRE(std::string(span.data(), span.size()) == "abcdefgh");
+  REQUIRE(ring.peek_pos() == 0);
+
+  auto prepared = ring.prepared_linear_span(8);
+  REQUIRE(prepared.data() == span.data() + 8);
+  std::memcpy(prepared.data(), "ijklmnop", 8);
+  ring.consume(8);
+  REQUIRE(ring.ready_write_size() == 0);
+  auto all = ring.peek_linear_span(16);
+  REQUIRE(std::string(all.data(), all.size()) == "abcdefghijklmnop");
+}
+
+Task deadline_consumer(RingBufferSpan &ring, TimerWheel &wheel,
+                       TimerWheel::time_point deadline,
+                       CancellationToken token, std::vector<WaitResult> &out) {
+  auto awaiter = ring.wait_not_empty(4, wheel, deadline, std::move(token));
+  out.push_back(co_await *awaiter);
+}
+
+TEST_CASE("wait_not_empty times out on simulated clock", "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  TimerWheel wheel;
+  std::vector<WaitResult> results;
+  auto consumer_coro = deadline_consumer(ring, wheel, 100, {}, results);
+  consumer_coro.resume();
+  REQUIRE(wheel.armed() == 1);
+
+  wheel.advance(99);
+  REQUIRE(results.empty());
+  wheel.advance(100);
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::timeout});
+
+  // timed out awaiter left the queue
+  REQUIRE(ring.waiting_not_empty_.empty());
+  ring.memcpy_in("abcd", 4);
+  REQUIRE(ring.woken_up() == 0);
+  REQUIRE(ring.woken_up_skipped() == 0);
+}
+
+TEST_CASE("repeated timeouts don't grow the waiting queue",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  TimerWheel wheel;
+  std::size_t timeouts = 0;
+  auto consumer_coro = [](RingBufferSpan &ring, TimerWheel &wheel,
+                          std::size_t &timeouts) -> Task {
+    while (true) {
+      auto awaiter = ring.wait_not_empty(4, wheel, wheel.now() + 1);
+      if (co_await *awaiter == WaitResult::ready) {
+        break;
+      }
+      timeouts++;
+    }
+  }(ring, wheel, timeouts);
+  consumer_coro.resume();
+  for (TimerWheel::time_point now = 1; now <= 1000; now++) {
+    wheel.advance(now);
+    REQUIRE(ring.waiting_not_empty_.size() == 1);
+  }
+  REQUIRE(timeouts == 1000);
+
+  ring.memcpy_in("abcd", 4);
+  REQUIRE(ring.waiting_not_empty_.empty());
+  REQUIRE(ring.woken_up() == 1);
+}
+
+TEST_CASE("wait_not_empty resumed by data disarms its deadline",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  TimerWheel wheel;
+  std::vector<WaitResult> results;
+  auto consumer_coro = deadline_consumer(ring, wheel, 100, {}, results);
+  consumer_coro.resume();
+
+  ring.memcpy_in("abcd", 4);
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::ready});
+  REQUIRE(wheel.armed() == 0);
+  wheel.advance(200);
+  REQUIRE(results.size() == 1);
+}
+
+TEST_CASE("wait_not_empty is cancelled by token", "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  TimerWheel wheel;
+  CancellationSource source;
+  std::vector<WaitResult> results;
+  auto consumer_coro =
+      deadline_consumer(ring, wheel, 100, source.token(), results);
+  consumer_coro.resume();
+
+  source.cancel();
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::cancelled});
+  REQUIRE(wheel.armed() == 0);
+  REQUIRE(ring.waiting_not_empty_.empty());
+
+  // already cancelled or expired waits don't suspend
+  auto cancelled_coro =
+      deadline_consumer(ring, wheel, 100, source.token(), results);
+  cancelled_coro.resume();
+  auto expired_coro = deadline_consumer(ring, wheel, 0, {}, results);
+  expired_coro.resume();
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::cancelled,
+                                             WaitResult::cancelled,
+                                             WaitResult::timeout});
+}
+
+TEST_CASE("cancel skips waiters destroyed by an earlier waiter",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  CancellationSource source;
+  std::vector<WaitResult> results;
+  std::coroutine_handle<> victim;
+  auto first_coro = [](RingBufferSpan &ring, CancellationToken token,
+                       std::coroutine_handle<> &victim,
+                       std::vector<WaitResult> &out) -> Task {
+    auto awaiter = ring.wait_not_empty(4, std::move(token));
+    out.push_back(co_await *awaiter);
+    victim.destroy();
+  }(ring, source.token(), victim, results);
+  TimerWheel wheel;
+  auto second_coro = deadline_consumer(ring, wheel, 100, source.token(),
+                                       results);
+  victim = second_coro;
+  first_coro.resume();
+  second_coro.resume();
+
+  source.cancel();
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::cancelled});
+  REQUIRE(wheel.armed() == 0);
+}
+
+TEST_CASE("waiters with a deadline outlive their ring", "[RingBufferCoro]") {
+  TimerWheel wheel;
+  std::vector<WaitResult> results;
+  std::optional<RingBufferSpan> ring;
+  ring.emplace(4096, 1024, 2048);
+  auto consumer_coro = deadline_consumer(*ring, wheel, 100, {}, results);
+  consumer_coro.resume();
+  ring.reset();
+
+  wheel.advance(100);
+  REQUIRE(results == std::vector<WaitResult>{WaitResult::timeout});
+}
+
+TEST_CASE("wait_not_full times out", "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<char> fill(ring.ready_write_size());
+  ring.memcpy_in(fill.data(), fill.size());
+  TimerWheel wheel;
+  WaitResult result = WaitResult::ready;
+  auto producer_coro = [](RingBufferSpan &ring, TimerWheel &wheel,
+                          WaitResult &result) -> Task {
+    auto awaiter = ring.wait_not_full(4, wheel, 10);
+    result = co_await *awaiter;
+  }(ring, wheel, result);
+  producer_coro.resume();
+  wheel.advance(10);
+  REQUIRE(result == WaitResult::timeout);
+  REQUIRE(ring.waiting_not_full_.empty());
+}
+
+Task line_parser(RingBufferSpan &ring, std::vector<std::string> &lines,
+                 std::size_t &scanned, std::size_t max_lines) {
+  while (lines.size() < max_lines) {
+    auto unparsed = ring.peek_unparsed_linear_span(
+        static_cast<int>(ring.unparsed_size()));
+    auto end = std::find(unparsed.begin(), unparsed.end(), '\n');
+    if (end == unparsed.end()) {
+      scanned += unparsed.size();
+      ring.advance_mark(unparsed.size());
+      auto awaiter = ring.wait_unparsed(1);
+      co_await *awaiter;
+      continue;
+    }
+    auto len = static_cast<std::size_t>(end - unparsed.begin()) + 1;
+    scanned += len;
+    ring.advance_mark(len);
+    auto line = ring.peek_linear_span(static_cast<int>(ring.mark()));
+    lines.emplace_back(line.data(), line.size() - 1);
+    ring.commit_to_mark();
+  }
+}
+
+TEST_CASE("parser resumes at the mark after every write",
+          "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<std::string> lines;
+  std::size_t scanned = 0;
+  auto parser = line_parser(ring, lines, scanned, 2);
+  parser.resume();
+
+  std::string input = "GET /a\nGET /bb\n";
+  for (char c : input) {
+    ring.memcpy_in(&c, 1);
+  }
+  REQUIRE(lines == std::vector<std::string>{"GET /a", "GET /bb"});
+  REQUIRE(scanned == input.size());
+  REQUIRE(ring.empty());
+  REQUIRE(ring.mark() == 0);
+}
+
+TEST_CASE("mark follows commits and rewinds", "[RingBufferCoro]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  ring.memcpy_in("abcdef", 6);
+  ring.advance_mark(4);
+  REQUIRE(ring.unparsed_size() == 2);
+  REQUIRE(std::string(ring.peek_unparsed_linear_span(2).data(), 2) == "ef");
+
+  ring.commit(1);
+  REQUIRE(ring.mark() == 3);
+  ring.rewind();
+  REQUIRE(ring.mark() == 0);
+  REQUIRE(ring.unparsed_size() == 5);
+  REQUIRE_THROWS_AS(ring.advance_mark(6), std::runtime_error);
+
+  ring.advance_mark(2);
+  ring.commit_to_mark();
+  REQUIRE(ring.ready_size() == 3);
+  REQUIRE(ring.mark() == 0);
+}
+
 } // namespace am
@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "ringbuffercoro.hpp"
+#include "ringbuffercursor.hpp"
+
+namespace am {
+
+using RingBufferSpan = RingBuffer<std::span<char>, std::span<char>>;
+
+TEST_CASE("writer and reader round trip fields", "[RingCursor]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+
+  RingWriter writer(ring);
+  writer.write<std::uint32_t>(0xdeadbeef);
+  writer.write<std::int16_t>(-2);
+  writer.write<double>(1.5);
+  writer.write_varint(300);
+  writer.write_zigzag(-65);
+  writer.write_string("hello");
+  REQUIRE(ring.ready_size() == 0);
+  writer.done();
+  REQUIRE(ring.ready_size() == 4 + 2 + 8 + 2 + 2 + 6);
+
+  RingReader reader(ring);
+  REQUIRE(reader.read<std::uint32_t>() == 0xdeadbeef);
+  REQUIRE(reader.read<std::int16_t>() == -2);
+  REQUIRE(reader.read<double>() == 1.5);
+  REQUIRE(reader.read_varint() == 300);
+  REQUIRE(reader.read_zigzag() == -65);
+  REQUIRE(reader.read_string() == "hello");
+  REQUIRE(reader.remaining() == 0);
+  reader.done();
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("cursors see messages crossing the end of the ring as linear",
+          "[RingCursor]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::size_t size = ring.ready_write_size();
+
+  // move both sequences close to the end
+  std::vector<char> filler(size - 3);
+  ring.memcpy_in(filler.data(), filler.size());
+  ring.memcpy_out(filler.data(), filler.size());
+
+  RingWriter writer(ring);
+  writer.write<std::uint64_t>(UINT64_MAX);
+  writer.write_string(std::string_view("wrapped"));
+  writer.done();
+
+  RingReader reader(ring);
+  REQUIRE(reader.read<std::uint64_t>() == UINT64_MAX);
+  auto str = reader.read_string();
+  REQUIRE(str == "wrapped");
+  reader.done();
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("cursors throw on overflow and leave the ring untouched",
+          "[RingCursor]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+
+  RingWriter writer(ring, 3);
+  REQUIRE_THROWS_AS(writer.write<std::uint32_t>(1), std::runtime_error);
+  writer.write_varint(1);
+  writer.done();
+
+  RingReader reader(ring);
+  REQUIRE_THROWS_AS(reader.read<std::uint16_t>(), std::runtime_error);
+  REQUIRE_THROWS_AS(reader.read_string(), std::runtime_error);
+  REQUIRE(reader.position() == 0);
+  REQUIRE(ring.ready_size() == 1);
+}
+
+TEST_CASE("rollback drops a half encoded message on a reused cursor",
+          "[RingCursor]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+
+  RingWriter writer(ring, 8);
+  writer.write<std::uint16_t>(1);
+  writer.done();
+  writer.write<std::uint32_t>(2);
+  REQUIRE_THROWS_AS(writer.write<std::uint32_t>(3), std::runtime_error);
+  writer.rollback();
+  writer.write<std::uint16_t>(4);
+  writer.done();
+  REQUIRE(ring.ready_size() == 4);
+
+  RingReader reader(ring);
+  REQUIRE(reader.read<std::uint16_t>() == 1);
+  reader.done();
+  reader.read<std::uint8_t>();
+  REQUIRE_THROWS_AS(reader.read<std::uint16_t>(), std::runtime_error);
+  reader.rollback();
+  reader.done();
+  REQUIRE(ring.ready_size() == 2);
+  REQUIRE(reader.read<std::uint16_t>() == 4);
+  reader.done();
+  REQUIRE(ring.empty());
+}
+
+} // namespace am
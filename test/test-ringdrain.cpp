@@ -0,0 +1,116 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "ringbuffercoro.hpp"
+#include "ringdrain.hpp"
+
+#if defined(__APPLE__) || defined(__linux__)
+#  include <cstdlib>
+#  include <unistd.h>
+#endif
+
+namespace am {
+
+#if defined(__APPLE__) || defined(__linux__)
+
+namespace {
+
+using RingBufferSpan = RingBuffer<std::span<char>, std::span<char>>;
+
+struct TempFile {
+  TempFile() {
+    fd_ = mkstemp(path_.data());
+    ::close(fd_);
+    fd_ = open_direct(path_.c_str());
+  }
+  ~TempFile() {
+    ::close(fd_);
+    ::unlink(path_.c_str());
+  }
+  std::string contents() const {
+    std::ifstream in(path_, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+  }
+
+  std::string path_{"/tmp/ringdrain_XXXXXX"};
+  int fd_;
+};
+
+std::string pattern(std::size_t len, char first) {
+  std::string res(len, 0);
+  for (std::size_t i = 0; i < len; i++) {
+    res[i] = static_cast<char>(first + i % 23);
+  }
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("drain writes whole pages and keeps the tail", "[DirectFileDrain]") {
+  TempFile file;
+  REQUIRE(file.fd_ != -1);
+  RingBufferSpan ring(1 << 16, 0, 1 << 16);
+  auto page = system_page_size();
+  DirectFileDrain drain(ring, file.fd_);
+
+  auto data = pattern(2 * page + page / 2, 'a');
+  ring.memcpy_in(data.data(), data.size());
+  REQUIRE(drain.drain() == static_cast<std::int64_t>(2 * page));
+  REQUIRE(ring.ready_size() == page / 2);
+  REQUIRE(file.contents() == data.substr(0, 2 * page));
+
+  REQUIRE(drain.flush() == static_cast<std::int64_t>(page / 2));
+  REQUIRE(drain.file_size() == data.size());
+  REQUIRE(file.contents() == data);
+
+  // tail page is written again together with the new bytes
+  auto more = pattern(page, 'A');
+  ring.memcpy_in(more.data(), more.size());
+  REQUIRE(drain.drain() == static_cast<std::int64_t>(page));
+  REQUIRE(drain.flush() == static_cast<std::int64_t>(page / 2));
+  REQUIRE(file.contents() == data + more);
+  REQUIRE(drain.file_size() == data.size() + more.size());
+}
+
+TEST_CASE("drain rejects rings which are not page aligned",
+          "[DirectFileDrain]") {
+  TempFile file;
+  RingBufferSpan ring(1 << 16, 0, 1 << 16);
+  DirectFileDrain drain(ring, file.fd_);
+  ring.memcpy_in("abc", 3);
+  ring.commit(1);
+  REQUIRE_THROWS_AS(drain.drain(), std::runtime_error);
+}
+
+TEST_CASE("drain rejects file offsets which are not page aligned",
+          "[DirectFileDrain]") {
+  TempFile file;
+  RingBufferSpan ring(1 << 16, 0, 1 << 16);
+  auto page = system_page_size();
+  REQUIRE_THROWS_AS(DirectFileDrain(ring, file.fd_, page / 2),
+                    std::runtime_error);
+  DirectFileDrain drain(ring, file.fd_, page);
+  REQUIRE(drain.file_size() == page);
+}
+
+TEST_CASE("drain rejects compact rings", "[DirectFileDrain]") {
+  TempFile file;
+  auto page = system_page_size();
+  // heap memory can be page aligned by chance, rejection must not depend on
+  // it
+  for (std::size_t size : {page, 2 * page, page + 1}) {
+    RingBufferSpan ring(size, 0, size, RingStorage::compact);
+    REQUIRE_FALSE(ring.mirrored());
+    REQUIRE_THROWS_AS(DirectFileDrain(ring, file.fd_), std::runtime_error);
+  }
+}
+
+#endif
+
+} // namespace am
@@ -0,0 +1,134 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ringlog.hpp"
+
+namespace am {
+
+namespace {
+
+std::vector<std::string> lines_without_timestamps(const std::string &out) {
+  std::vector<std::string> lines;
+  std::istringstream in(out);
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line.substr(line.find(' ') + 1));
+  }
+  return lines;
+}
+
+} // namespace
+
+TEST_CASE("records are formatted when drained", "[RingLog]") {
+  std::ostringstream out;
+  RingLog log(out);
+  auto connected = log.register_format("connected {} port {} ratio {}");
+  auto plain = log.register_format("no args");
+
+  REQUIRE(log.log(connected, std::string_view("example.com"), 8080u, 0.5));
+  REQUIRE(log.log(plain));
+  REQUIRE(out.str().empty());
+
+  REQUIRE(log.drain() == 2);
+  REQUIRE(lines_without_timestamps(out.str()) ==
+          std::vector<std::string>{"connected example.com port 8080 ratio 0.5",
+                                   "no args"});
+}
+
+TEST_CASE("negative numbers and missing arguments", "[RingLog]") {
+  std::ostringstream out;
+  RingLog log(out);
+  auto id = log.register_format("{} and {}");
+  log.log(id, -42);
+  log.drain();
+  REQUIRE(lines_without_timestamps(out.str()) ==
+          std::vector<std::string>{"-42 and {}"});
+}
+
+TEST_CASE("records are dropped when thread ring is full", "[RingLog]") {
+  std::ostringstream out;
+  RingLog log(out, 4096);
+  auto id = log.register_format("{}");
+  std::string big(4000, 'x');
+  REQUIRE(log.log(id, std::string_view(big)));
+  REQUIRE_FALSE(log.log(id, std::string_view(big)));
+  REQUIRE(log.dropped() == 1);
+  REQUIRE(log.drain() == 1);
+  REQUIRE(log.log(id, std::string_view(big)));
+}
+
+TEST_CASE("background thread drains rings of all threads", "[RingLog]") {
+  std::ostringstream out;
+  constexpr int per_thread = 1000;
+  {
+    RingLog log(out);
+    auto id = log.register_format("thread {} record {}");
+    log.start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&log, id, t] {
+        for (int i = 0; i < per_thread;) {
+          if (log.log(id, t, i)) {
+            i++;
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+  REQUIRE(lines_without_timestamps(out.str()).size() == 4 * per_thread);
+}
+
+TEST_CASE("rings of exited threads are released once drained", "[RingLog]") {
+  std::ostringstream out;
+  RingLog log(out);
+  auto id = log.register_format("thread {}");
+  for (int t = 0; t < 8; t++) {
+    std::thread([&log, id, t] { log.log(id, t); }).join();
+  }
+  REQUIRE(log.thread_rings() == 8);
+  REQUIRE(log.drain() == 8);
+  REQUIRE(log.thread_rings() == 0);
+
+  log.log(id, -1);
+  REQUIRE(log.drain() == 1);
+  REQUIRE(log.thread_rings() == 1);
+}
+
+#if defined(__linux__)
+TEST_CASE("rings of destroyed logs are released by the thread",
+          "[RingLog]") {
+  auto mappings = [] {
+    std::ifstream maps("/proc/self/maps");
+    std::size_t lines = 0;
+    for (std::string line; std::getline(maps, line);) {
+      lines++;
+    }
+    return lines;
+  };
+  std::ostringstream out;
+  {
+    RingLog log(out);
+    log.log(log.register_format("warm up"));
+  }
+  auto before = mappings();
+  for (int i = 0; i < 50; i++) {
+    RingLog log(out);
+    log.log(log.register_format("log {}"), i);
+  }
+  // each live ring would keep two mappings
+  REQUIRE(mappings() < before + 10);
+}
+#endif
+
+} // namespace am
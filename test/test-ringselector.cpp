@@ -0,0 +1,190 @@
+#include <catch2/catch_test_macros.hpp>
+#include <coroutine>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "ringbuffercoro.hpp"
+#include "ringselector.hpp"
+
+namespace am {
+
+using RingBufferSpan = RingBuffer<std::span<char>, std::span<char>>;
+
+struct SelectTask {
+  struct promise_type {
+    SelectTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+};
+
+SelectTask serve(RingSelector &selector, std::vector<RingBufferSpan *> rings,
+                 std::vector<std::vector<std::size_t>> &wakeups,
+                 std::size_t iterations) {
+  for (std::size_t i = 0; i < iterations; i++) {
+    const auto &ready = co_await selector.wait();
+    wakeups.push_back(ready);
+    for (auto index : ready) {
+      int value = 0;
+      rings[index]->memcpy_out(&value, sizeof(value));
+    }
+  }
+}
+
+TEST_CASE("selector resumes once with the rings which became readable",
+          "[RingSelector]") {
+  RingBufferSpan ring0(4096, 1024, 2048);
+  RingBufferSpan ring1(4096, 1024, 2048);
+  RingBufferSpan ring2(4096, 1024, 2048);
+  RingSelector selector;
+  REQUIRE(selector.add(ring0, RingSelector::Interest::readable, 4) == 0);
+  REQUIRE(selector.add(ring1, RingSelector::Interest::readable, 4) == 1);
+  REQUIRE(selector.add(ring2, RingSelector::Interest::readable, 4) == 2);
+
+  std::vector<std::vector<std::size_t>> wakeups;
+  serve(selector, {&ring0, &ring1, &ring2}, wakeups, 2);
+  REQUIRE(wakeups.empty());
+
+  int value = 1;
+  ring1.memcpy_in(&value, sizeof(value));
+  REQUIRE(wakeups == std::vector<std::vector<std::size_t>>{{1}});
+
+  // below threshold does not wake up
+  ring2.memcpy_in(&value, 2);
+  REQUIRE(wakeups.size() == 1);
+  ring2.memcpy_in(&value, 2);
+  REQUIRE(wakeups.size() == 2);
+  REQUIRE(wakeups[1] == std::vector<std::size_t>{2});
+
+  // registration survives iterations
+  REQUIRE(ring0.selecting_not_empty_.size() == 1);
+  REQUIRE(ring1.selecting_not_empty_.size() == 1);
+  REQUIRE(ring2.selecting_not_empty_.size() == 1);
+}
+
+TEST_CASE("selector reports again rings which were not drained",
+          "[RingSelector]") {
+  RingBufferSpan ring0(4096, 1024, 2048);
+  RingBufferSpan ring1(4096, 1024, 2048);
+  RingSelector selector;
+  selector.add(ring0, RingSelector::Interest::readable, 4);
+  selector.add(ring1, RingSelector::Interest::readable, 4);
+
+  int values[2] = {1, 2};
+  ring0.memcpy_in(values, sizeof(values));
+
+  std::vector<std::vector<std::size_t>> wakeups;
+  serve(selector, {&ring0, &ring1}, wakeups, 2);
+  // one int left in ring0 is reported without a new notification
+  REQUIRE(wakeups == std::vector<std::vector<std::size_t>>{{0}, {0}});
+  REQUIRE(ring0.empty());
+}
+
+SelectTask forward(RingSelector &selector, RingBufferSpan &in,
+                   RingBufferSpan &out,
+                   std::vector<std::vector<std::size_t>> &wakeups,
+                   std::size_t iterations) {
+  for (std::size_t i = 0; i < iterations; i++) {
+    const auto &ready = co_await selector.wait();
+    wakeups.push_back(ready);
+    int value = 0;
+    while (in.ready_size() >= sizeof(value)) {
+      in.memcpy_out(&value, sizeof(value));
+      // queues out in the selector while the coroutine is running
+      out.memcpy_in(&value, sizeof(value));
+      out.memcpy_out(&value, sizeof(value));
+    }
+  }
+}
+
+TEST_CASE("selector does not resume for entries drained in between",
+          "[RingSelector]") {
+  RingBufferSpan in(4096, 1024, 2048);
+  RingBufferSpan out(4096, 1024, 2048);
+  RingSelector selector;
+  selector.add(in, RingSelector::Interest::readable, 4);
+  selector.add(out, RingSelector::Interest::readable, 4);
+
+  std::vector<std::vector<std::size_t>> wakeups;
+  forward(selector, in, out, wakeups, 2);
+  int value = 1;
+  in.memcpy_in(&value, sizeof(value));
+  REQUIRE(wakeups == std::vector<std::vector<std::size_t>>{{0}});
+  in.memcpy_in(&value, sizeof(value));
+  REQUIRE(wakeups == std::vector<std::vector<std::size_t>>{{0}, {0}});
+}
+
+SelectTask remove_when_woken(RingSelector &selector, std::size_t index,
+                             bool &woken) {
+  co_await selector.wait();
+  woken = true;
+  selector.remove(index);
+}
+
+TEST_CASE("ring notifies every selector when one removes itself",
+          "[RingSelector]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  RingSelector first;
+  RingSelector second;
+  auto first_index = first.add(ring, RingSelector::Interest::readable, 4);
+  auto second_index = second.add(ring, RingSelector::Interest::readable, 4);
+  bool first_woken = false;
+  bool second_woken = false;
+  remove_when_woken(first, first_index, first_woken);
+  remove_when_woken(second, second_index, second_woken);
+
+  int value = 1;
+  ring.memcpy_in(&value, sizeof(value));
+  REQUIRE(first_woken);
+  REQUIRE(second_woken);
+  REQUIRE(ring.selecting_not_empty_.empty());
+}
+
+TEST_CASE("selector waits for writable rings", "[RingSelector]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<char> fill(ring.ready_write_size());
+  ring.memcpy_in(fill.data(), fill.size());
+
+  RingSelector selector;
+  selector.add(ring, RingSelector::Interest::writable, 8);
+  REQUIRE_FALSE(selector.is_ready(0));
+
+  ring.commit(4);
+  REQUIRE_FALSE(selector.is_ready(0));
+  ring.commit(4);
+  REQUIRE(selector.is_ready(0));
+}
+
+TEST_CASE("commit resumes selector waiting for a writable ring",
+          "[RingSelector]") {
+  RingBufferSpan ring(4096, 1024, 2048);
+  std::vector<char> fill(ring.ready_write_size());
+  ring.memcpy_in(fill.data(), fill.size());
+
+  RingSelector selector;
+  selector.add(ring, RingSelector::Interest::writable, 8);
+  std::vector<std::vector<std::size_t>> wakeups;
+  serve(selector, {&ring}, wakeups, 1);
+  REQUIRE(wakeups.empty());
+
+  ring.commit(4);
+  REQUIRE(wakeups.empty());
+  ring.commit(4);
+  REQUIRE(wakeups == std::vector<std::vector<std::size_t>>{{0}});
+}
+
+TEST_CASE("selector entries are detached when ring is destroyed",
+          "[RingSelector]") {
+  RingSelector selector;
+  {
+    RingBufferSpan ring(4096, 1024, 2048);
+    selector.add(ring, RingSelector::Interest::readable, 1);
+  }
+  REQUIRE_FALSE(selector.is_ready(0));
+  selector.remove(0);
+}
+
+} // namespace am
@@ -0,0 +1,194 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "shardedring.hpp"
+
+namespace am {
+
+struct ShardTask {
+  struct promise_type {
+    ShardTask get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+
+  // only valid while the coroutine is suspended
+  std::coroutine_handle<promise_type> handle_;
+};
+
+ShardTask shard_consumer(ShardedRing &ring, std::size_t home,
+                         std::vector<std::string> &got) {
+  while (got.empty()) {
+    co_await *ring.wait_not_empty(home);
+    ring.drain(home, 16, [&got](std::string_view r) { got.emplace_back(r); });
+  }
+}
+
+TEST_CASE("consumers drain home shard first", "[ShardedRing]") {
+  ShardedRing ring(2, 4096);
+  REQUIRE(ring.try_push(0, bytes_view("a", 1)));
+  REQUIRE(ring.try_push(1, bytes_view("bb", 2)));
+
+  std::vector<std::string> got;
+  auto f = [&got](std::string_view r) { got.emplace_back(r); };
+  REQUIRE(ring.drain(1, 16, f) == 1);
+  REQUIRE(got == std::vector<std::string>{"bb"});
+  REQUIRE(ring.stolen() == 0);
+}
+
+TEST_CASE("consumers steal a batch when home shard is empty",
+          "[ShardedRing]") {
+  ShardedRing ring(3, 4096);
+  for (char c = 'a'; c < 'f'; c++) {
+    REQUIRE(ring.try_push(2, bytes_view(&c, 1)));
+  }
+
+  std::vector<std::string> got;
+  auto f = [&got](std::string_view r) { got.emplace_back(r); };
+  REQUIRE(ring.drain(0, 3, f) == 3);
+  REQUIRE(got == std::vector<std::string>{"a", "b", "c"});
+  REQUIRE(ring.stolen() == 3);
+  REQUIRE(ring.drain(1, 3, f) == 2);
+  REQUIRE(ring.drain(1, 3, f) == 0);
+}
+
+TEST_CASE("push fails when shard is full", "[ShardedRing]") {
+  ShardedRing ring(1, 4096);
+  std::vector<char> big(ring.ready_size(0) + 4096 - sizeof(int));
+  REQUIRE(ring.try_push(0, bytes_view(big.data(), big.size())));
+  REQUIRE_FALSE(ring.try_push(0, bytes_view("x", 1)));
+}
+
+TEST_CASE("push wakes up coroutine waiting on the shard", "[ShardedRing]") {
+  ShardedRing ring(2, 4096);
+  std::vector<std::string> got;
+  shard_consumer(ring, 1, got);
+  REQUIRE(got.empty());
+
+  REQUIRE(ring.try_push(1, bytes_view("wake", 4)));
+  REQUIRE(got == std::vector<std::string>{"wake"});
+}
+
+TEST_CASE("push wakes up waiters of a shard in order", "[ShardedRing]") {
+  ShardedRing ring(1, 4096);
+  std::vector<std::string> first;
+  std::vector<std::string> second;
+  shard_consumer(ring, 0, first);
+  shard_consumer(ring, 0, second);
+
+  REQUIRE(ring.try_push(0, bytes_view("a", 1)));
+  REQUIRE(first == std::vector<std::string>{"a"});
+  REQUIRE(second.empty());
+  REQUIRE(ring.try_push(0, bytes_view("b", 1)));
+  REQUIRE(second == std::vector<std::string>{"b"});
+}
+
+TEST_CASE("push does not crash when waiting coroutine is destroyed",
+          "[ShardedRing]") {
+  ShardedRing ring(1, 4096);
+  std::vector<std::string> destroyed;
+  shard_consumer(ring, 0, destroyed).handle_.destroy();
+  std::vector<std::string> got;
+  shard_consumer(ring, 0, got);
+
+  REQUIRE(ring.try_push(0, bytes_view("a", 1)));
+  REQUIRE(destroyed.empty());
+  REQUIRE(got == std::vector<std::string>{"a"});
+}
+
+TEST_CASE("push wakes up a consumer parked on another shard to steal",
+          "[ShardedRing]") {
+  ShardedRing ring(3, 4096);
+  std::vector<std::string> got;
+  shard_consumer(ring, 1, got);
+
+  REQUIRE(ring.try_push(0, bytes_view("skewed", 6)));
+  REQUIRE(got == std::vector<std::string>{"skewed"});
+  REQUIRE(ring.stolen() == 1);
+}
+
+TEST_CASE("consumer about to park steals records of other shards",
+          "[ShardedRing]") {
+  ShardedRing ring(2, 4096);
+  // pushed while nobody waits, the consumer only checks its home shard
+  // before suspending
+  REQUIRE(ring.try_push(0, bytes_view("early", 5)));
+  std::vector<std::string> got;
+  shard_consumer(ring, 1, got);
+  REQUIRE(got == std::vector<std::string>{"early"});
+}
+
+TEST_CASE("drain can be reentered from the callback", "[ShardedRing]") {
+  // e.g. the callback pushes and resumes a consumer on this thread
+  ShardedRing ring(2, 4096);
+  REQUIRE(ring.try_push(0, bytes_view("a", 1)));
+  REQUIRE(ring.try_push(0, bytes_view("bb", 2)));
+  std::string nested_record(64, 'z');
+  REQUIRE(ring.try_push(1, bytes_view(nested_record)));
+
+  // same callback type in both calls, like a stage which forwards to itself
+  std::vector<std::string> got;
+  std::vector<std::string> nested;
+  std::function<void(std::string_view)> inner = [&nested](std::string_view r) {
+    nested.emplace_back(r);
+  };
+  std::function<void(std::string_view)> outer = [&](std::string_view r) {
+    got.emplace_back(r);
+    ring.drain(1, 16, inner);
+  };
+  REQUIRE(ring.drain(0, 16, outer) == 2);
+  REQUIRE(got == std::vector<std::string>{"a", "bb"});
+  REQUIRE(nested == std::vector<std::string>{nested_record});
+}
+
+TEST_CASE("every record is consumed exactly once across threads",
+          "[ShardedRing]") {
+  constexpr std::size_t threads = 4;
+  constexpr std::size_t per_thread = 10000;
+  ShardedRing ring(threads, 4096);
+  std::atomic<std::size_t> consumed{};
+  std::atomic<std::size_t> sum{};
+
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&ring, t] {
+      for (std::size_t i = 1; i <= per_thread;) {
+        if (ring.try_push(ring.shard_for_key(t / 2),
+                          bytes_view(reinterpret_cast<const char *>(&i),
+                                     sizeof(i)))) {
+          i++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    workers.emplace_back([&ring, &consumed, &sum, t] {
+      while (consumed.load() < threads * per_thread) {
+        consumed += ring.drain(t, 32, [&sum](std::string_view r) {
+          std::size_t i = 0;
+          std::memcpy(&i, r.data(), sizeof(i));
+          sum += i;
+        });
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  REQUIRE(consumed.load() == threads * per_thread);
+  REQUIRE(sum.load() == threads * per_thread * (per_thread + 1) / 2);
+}
+
+} // namespace am
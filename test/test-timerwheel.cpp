@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "timerwheel.hpp"
+
+namespace am {
+
+TEST_CASE("timers fire at their tick", "[TimerWheel]") {
+  TimerWheel wheel(1000);
+  TimerWheel::Timer near;
+  TimerWheel::Timer far;
+  TimerWheel::Timer past;
+  std::vector<int> fired;
+  wheel.arm(near, 1005, [&fired] { fired.push_back(1); });
+  wheel.arm(far, 1000 + 70000, [&fired] { fired.push_back(2); });
+  wheel.arm(past, 10, [&fired] { fired.push_back(3); });
+  REQUIRE(wheel.armed() == 3);
+
+  wheel.advance(1004);
+  REQUIRE(fired == std::vector<int>{3});
+  wheel.advance(1005);
+  REQUIRE(fired == std::vector<int>{3, 1});
+  wheel.advance(1000 + 69999);
+  REQUIRE(fired.size() == 2);
+  REQUIRE(far.armed());
+  wheel.advance(1000 + 70000);
+  REQUIRE(fired == std::vector<int>{3, 1, 2});
+  REQUIRE(wheel.armed() == 0);
+}
+
+TEST_CASE("cancelled and destroyed timers don't fire", "[TimerWheel]") {
+  TimerWheel wheel;
+  int fired = 0;
+  TimerWheel::Timer cancelled;
+  wheel.arm(cancelled, 5, [&fired] { fired++; });
+  {
+    TimerWheel::Timer destroyed;
+    wheel.arm(destroyed, 5, [&fired] { fired++; });
+  }
+  cancelled.cancel();
+  REQUIRE(wheel.armed() == 0);
+  wheel.advance(10);
+  REQUIRE(fired == 0);
+}
+
+TEST_CASE("timers beyond the wheel range are cascaded again",
+          "[TimerWheel]") {
+  TimerWheel wheel;
+  TimerWheel::Timer timer;
+  std::uint64_t fired_at = 0;
+  std::uint64_t expires = (std::uint64_t(1) << 33) + 12345;
+  wheel.arm(timer, expires, [&] { fired_at = wheel.now(); });
+  wheel.advance(expires - 1);
+  REQUIRE(fired_at == 0);
+  wheel.advance(expires + 1000);
+  REQUIRE(fired_at == expires);
+}
+
+TEST_CASE("100k timers with half cancelled fire exactly on time",
+          "[TimerWheel]") {
+  constexpr std::size_t count = 100000;
+  TimerWheel wheel;
+  std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  std::vector<std::uint64_t> expires(count);
+  std::vector<std::uint64_t> fired_at(count);
+  std::mt19937_64 rng(42);
+  for (std::size_t i = 0; i < count; i++) {
+    timers.push_back(std::make_unique<TimerWheel::Timer>());
+    expires[i] = 1 + rng() % (1 << 20);
+    wheel.arm(*timers[i], expires[i],
+              [&wheel, &fired_at, i] { fired_at[i] = wheel.now(); });
+  }
+  REQUIRE(wheel.armed() == count);
+  for (std::size_t i = 0; i < count; i += 2) {
+    timers[i]->cancel();
+  }
+  REQUIRE(wheel.armed() == count / 2);
+
+  wheel.advance(1 << 20);
+  REQUIRE(wheel.armed() == 0);
+  for (std::size_t i = 0; i < count; i++) {
+    REQUIRE(fired_at[i] == (i % 2 ? expires[i] : 0));
+  }
+}
+
+} // namespace am